@@ -0,0 +1,216 @@
+#include <space.hpp>
+#include <time.hpp>
+#include <xorshift.hpp>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+namespace {
+    struct object {
+        std::uint32_t value;
+    };
+
+    /// Depth of the benchmarked universes: 8192x8192 cells.
+    constexpr std::size_t depth = 14;
+
+    /// Number of runs of each benchmark; the fastest run is reported.
+    constexpr std::size_t runs = 3;
+
+    /// Return the time taken by a function [seconds].
+    template<typename F>
+    double measure(F&& f) {
+        double start = now();
+        f();
+        return now() - start;
+    }
+
+    /// 'n' distinct positions picked at random in the whole universe.
+    std::vector<space::vec_t> sparse_positions(std::size_t n) {
+        const space::pos_t half = (space::pos_t(1) << (depth-1))/2;
+        xorshift rng(42);
+
+        std::unordered_set<std::uint64_t> taken;
+        std::vector<space::vec_t> positions;
+        positions.reserve(n);
+        while (positions.size() != n) {
+            space::vec_t p(space::pos_t(rng() % (2*half)) - half,
+                space::pos_t(rng() % (2*half)) - half);
+            std::uint64_t key = (std::uint64_t(std::uint32_t(p.x)) << 32) | std::uint32_t(p.y);
+            if (taken.insert(key).second) {
+                positions.push_back(p);
+            }
+        }
+
+        return positions;
+    }
+
+    /// Return a copy of the provided positions in a random order.
+    std::vector<space::vec_t> shuffled(std::vector<space::vec_t> positions, std::uint32_t seed) {
+        xorshift rng(seed);
+        for (std::size_t i = positions.size(); i > 1; --i) {
+            std::swap(positions[i-1], positions[rng() % i]);
+        }
+
+        return positions;
+    }
+
+    /// All the positions of a square of n cells at the center of the universe, shuffled.
+    std::vector<space::vec_t> dense_positions(std::size_t n) {
+        const space::pos_t side = space::pos_t(std::sqrt(double(n)));
+        std::vector<space::vec_t> positions;
+        positions.reserve(side*side);
+        for (space::pos_t y = -side/2; y < side - side/2; ++y)
+        for (space::pos_t x = -side/2; x < side - side/2; ++x) {
+            positions.push_back(space::vec_t(x, y));
+        }
+
+        return shuffled(std::move(positions), 42);
+    }
+
+    void print_row(const std::string& name, double t, std::size_t n,
+        const std::string& unit = "cell") {
+        std::cout << "  " << std::left << std::setw(12) << name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(2) << t*1e3 << " ms"
+            << std::setw(12) << std::setprecision(1) << t*1e9/n << " ns/" << unit << std::endl;
+    }
+
+    /// Count the cells that exist and hold an object; empty cells are only found in trees.
+    std::size_t occupied(const space::cell<object>* c) {
+        return c && !c->empty() ? 1 : 0;
+    }
+
+    /// Create, empty and destroy the cells of a quad-tree one by one.
+    /** This goes through the allocation of split cells (see ctl::slab_pool). A first universe
+        is filled and destroyed. A second one is filled, emptied and filled again, so that the
+        second fill reuses the memory of the cells that have been collapsed in between.
+    **/
+    void bench_tree_allocation(const std::string& name, const std::vector<space::vec_t>& pos) {
+        auto fill_all = [&](space::universe<object>& u) {
+            for (auto& p : pos) {
+                u.reach(p).fill(std::make_unique<object>(object{1}));
+            }
+        };
+
+        double fill = 1e9, destroy = 1e9, clear = 1e9, refill = 1e9;
+        for (std::size_t r = 0; r < runs; ++r) {
+            auto u = space::universe<object>::make<depth>(space::storage::tree);
+            fill = std::min(fill, measure([&]() { fill_all(*u); }));
+            destroy = std::min(destroy, measure([&]() { u = nullptr; }));
+
+            u = space::universe<object>::make<depth>(space::storage::tree);
+            u->set_collapse_delay(0);
+            fill_all(*u);
+
+            clear = std::min(clear, measure([&]() {
+                for (auto& p : pos) {
+                    u->try_reach(p)->clear();
+                }
+
+                u->collapse();
+            }));
+
+            refill = std::min(refill, measure([&]() { fill_all(*u); }));
+        }
+
+        std::cout << name << " (" << pos.size() << " cells)" << std::endl;
+        print_row("fill", fill, pos.size());
+        print_row("destroy", destroy, pos.size());
+        print_row("clear", clear, pos.size());
+        print_row("refill", refill, pos.size());
+    }
+
+    /// Compare the operations of a quad-tree and a linear universe holding the same cells.
+    void bench_storage(const std::string& name, const std::vector<space::vec_t>& pos,
+        space::storage s) {
+
+        // Cells are looked up in an order that does not depend on the order in which they
+        // were stored, else the timings depend on how the storage laid out its memory
+        const auto lookup = shuffled(pos, 7);
+
+        // Boxes of 64x64 cells around some of the stored cells
+        std::vector<space::box_t> boxes;
+        for (std::size_t i = 0; i < pos.size(); i += pos.size()/1000) {
+            boxes.push_back(space::box_t(pos[i] - space::vec_t(32,32), pos[i] + space::vec_t(31,31)));
+        }
+
+        double fill = 1e9, reach = 1e9, miss = 1e9, neighbor = 1e9, each = 1e9, query = 1e9,
+            destroy = 1e9;
+        std::size_t found = 0;
+        for (std::size_t r = 0; r < runs; ++r) {
+            auto u = space::universe<object>::make<depth>(s);
+
+            std::vector<space::universe<object>::positioned_object> objects;
+            objects.reserve(pos.size());
+            for (auto& p : pos) {
+                objects.emplace_back(p, std::make_unique<object>(object{1}));
+            }
+
+            fill = std::min(fill, measure([&]() { u->bulk_fill(objects); }));
+
+            const space::universe<object>& cu = *u;
+            found = 0;
+            reach = std::min(reach, measure([&]() {
+                for (auto& p : lookup) {
+                    found += cu.try_reach(p)->content().value;
+                }
+            }));
+
+            miss = std::min(miss, measure([&]() {
+                for (auto& p : lookup) {
+                    found += occupied(cu.try_reach(space::vec_t(p.y, p.x) + space::vec_t(1,0)));
+                }
+            }));
+
+            neighbor = std::min(neighbor, measure([&]() {
+                for (auto& p : lookup) {
+                    found += occupied(cu.try_reach(p)->try_reach(space::direction::right));
+                }
+            }));
+
+            each = std::min(each, measure([&]() {
+                cu.for_each_cell([&](const object& o) { found += o.value; });
+            }));
+
+            query = std::min(query, measure([&]() {
+                for (auto& b : boxes) {
+                    for (auto& c : cu.query(b)) {
+                        found += c.content().value;
+                    }
+                }
+            }));
+
+            destroy = std::min(destroy, measure([&]() { u = nullptr; }));
+        }
+
+        std::cout << name << " (" << pos.size() << " cells, " << found << ")" << std::endl;
+        print_row("bulk_fill", fill, pos.size());
+        print_row("try_reach", reach, pos.size());
+        print_row("miss", miss, pos.size());
+        print_row("neighbor", neighbor, pos.size());
+        print_row("for_each", each, pos.size());
+        print_row("query", query, boxes.size(), "box");
+        print_row("destroy", destroy, pos.size());
+    }
+}
+
+int main() {
+    const auto sparse = sparse_positions(200000);
+    const auto dense = dense_positions(1000000);
+
+    std::cout << "split cell allocation, depth " << depth << std::endl;
+    bench_tree_allocation("sparse", sparse);
+    bench_tree_allocation("dense", dense);
+
+    std::cout << std::endl << "tree storage, depth " << depth << std::endl;
+    bench_storage("sparse", sparse, space::storage::tree);
+    bench_storage("dense", dense, space::storage::tree);
+
+    std::cout << std::endl << "linear storage, depth " << depth << std::endl;
+    bench_storage("sparse", sparse, space::storage::linear);
+    bench_storage("dense", dense, space::storage::linear);
+
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "client_netcom.hpp"
 #include "server_netcom.hpp"
 #include <config.hpp>
+#include <packet_socket.hpp>
 
 namespace client {
     netcom::netcom(config::state& conf, logger& out) :
@@ -69,6 +70,7 @@ namespace client {
         });
 
         sf::TcpSocket socket;
+        packet_receiver receiver;
 
         // Try to connect
         std::size_t wait_count = 5;
@@ -78,7 +80,7 @@ namespace client {
                 send_message(self_actor_id, message::server::connection_established{});
 
                 out_packet_t op(server_actor_id);
-                if (socket.receive(op.impl) == sf::Socket::Done) {
+                if (receiver.receive(socket, op.impl) == sf::Socket::Done) {
                     auto opv = op.view();
                     netcom_impl::packet_type t;
                     opv >> t;
@@ -143,7 +145,7 @@ namespace client {
             // Receive incoming packets
             in_packet_t ip(server_actor_id);
             socket.setBlocking(false);
-            switch (socket.receive(ip.impl)) {
+            switch (receiver.receive(socket, ip.impl)) {
             case sf::Socket::Done :
                 input_.push(std::move(ip));
                 break;
@@ -165,7 +167,7 @@ namespace client {
             out_packet_t op;
             while (output_.try_pop(op)) {
                 if (op.to == server_actor_id) {
-                    switch (socket.send(op.impl)) {
+                    switch (send_packet(socket, op.impl)) {
                     case sf::Socket::Done : break;
                     default :
                         send_message(self_actor_id, make_packet<message::server::connection_failed>(
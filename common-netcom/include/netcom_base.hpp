@@ -626,9 +626,8 @@ protected :
     template<typename MessageType, typename ... Args>
     out_packet_t create_message_(Args&& ... args) {
         out_packet_t p;
-        p << netcom_impl::packet_type::message;
-        p << MessageType::packet_id__;
-        packet_write(p, std::forward<Args>(args)...);
+        packet_write_exact(p.impl, netcom_impl::packet_type::message, MessageType::packet_id__,
+            args...);
         return p;
     }
 
@@ -640,10 +639,8 @@ protected :
         }
 
         out_packet_t p;
-        p << netcom_impl::packet_type::request;
-        p << RequestType::packet_id__;
-        p << rid;
-        packet_write(p, std::forward<Args>(args)...);
+        packet_write_exact(p.impl, netcom_impl::packet_type::request, RequestType::packet_id__,
+            rid, args...);
         return p;
     }
 
@@ -883,9 +880,7 @@ private :
     template<typename ... Args>
     void send_answer_(actor_id_t aid, request_id_t rid, Args&& ... args) {
         out_packet_t p(aid);
-        p << netcom_impl::packet_type::answer;
-        p << rid;
-        packet_write(p, std::forward<Args>(args)...);
+        packet_write_exact(p.impl, netcom_impl::packet_type::answer, rid, args...);
         send(std::move(p));
     }
 
@@ -893,9 +888,7 @@ private :
     template<typename ... Args>
     void send_failure_(actor_id_t aid, request_id_t rid, Args&& ... args) {
         out_packet_t p(aid);
-        p << netcom_impl::packet_type::failure;
-        p << rid;
-        packet_write(p, std::forward<Args>(args)...);
+        packet_write_exact(p.impl, netcom_impl::packet_type::failure, rid, args...);
         send(std::move(p));
     }
 
@@ -1,7 +1,6 @@
 #ifndef PACKET_HPP
 #define PACKET_HPP
 
-#include <SFML/Network/Packet.hpp>
 #include <vector>
 #include <atomic>
 #include <array>
@@ -10,108 +9,538 @@
 #include <sorted_vector.hpp>
 #include <range.hpp>
 #include <serialized_packet.hpp>
+#include <endian.hpp>
+#include <cstring>
 
 struct color32;
 
-namespace sf {
-    // Extend sf::Packet to handle 64bit types
-    #ifdef HAS_UINT64_T
-    packet_t::base& operator << (packet_t::base& p, std::uint64_t data);
-    packet_t::base& operator >> (packet_t::base& p, std::uint64_t& data);
+template<typename T, typename enable = typename std::enable_if<std::is_enum<T>::value>::type>
+packet_t::base& operator >> (packet_t::base& p, T& t) {
+    return p >> reinterpret_cast<typename std::underlying_type<T>::type&>(t);
+}
+
+template<typename T, typename enable = typename std::enable_if<std::is_enum<T>::value>::type>
+packet_t::base& operator << (packet_t::base& p, T t) {
+    return p << static_cast<typename std::underlying_type<T>::type>(t);
+}
+
+packet_t::base& operator << (packet_t::base& o, ctl::empty_t);
+packet_t::base& operator >> (packet_t::base& i, ctl::empty_t);
+
+namespace packet_impl {
+    /// Check if values of type T have a fixed size encoding, so arrays of them can be
+    /// written and read in bulk.
+    /** This is the case of the arithmetic types that have a native serialized_packet
+        operator, and of the enums based on them.
+    **/
+    template<typename T, typename enable = void>
+    struct is_bulk_type : std::integral_constant<bool,
+        std::is_same<T,std::int8_t>::value  || std::is_same<T,std::uint8_t>::value  ||
+        std::is_same<T,std::int16_t>::value || std::is_same<T,std::uint16_t>::value ||
+        std::is_same<T,std::int32_t>::value || std::is_same<T,std::uint32_t>::value ||
+        std::is_same<T,std::int64_t>::value || std::is_same<T,std::uint64_t>::value ||
+        std::is_same<T,float>::value        || std::is_same<T,double>::value> {};
+
+    template<typename T>
+    struct is_bulk_type<T, typename std::enable_if<std::is_enum<T>::value>::type> :
+        is_bulk_type<typename std::underlying_type<T>::type> {};
+
+    /// Check if the encoding of T is identical to its representation in memory.
+    /** Floating point numbers are always stored in their native representation, and
+        integers in big endian.
+    **/
+    template<typename T>
+    using is_raw_bulk_type = std::integral_constant<bool,
+        std::is_floating_point<T>::value || sizeof(T) == 1
+    #ifdef BOOST_BIG_ENDIAN
+        || true
+    #endif
+    >;
+
+    template<typename T>
+    void encode_bulk(const T* in, std::size_t n, char* out, std::true_type) {
+        std::memcpy(out, in, n*sizeof(T));
+    }
+
+    inline std::uint8_t byte_swap(std::uint8_t u) {
+        return u;
+    }
+
+    inline std::uint16_t byte_swap(std::uint16_t u) {
+        return std::uint16_t((u << 8) | (u >> 8));
+    }
+
+    inline std::uint32_t byte_swap(std::uint32_t u) {
+    #if defined(__GNUC__)
+        return __builtin_bswap32(u);
     #else
-    struct impl_u64 {
-        std::uint32_t lo, hi;
-        bool operator < (const impl_u64& i) const;
-    };
-    packet_t::base& operator << (packet_t::base& p, impl_u64 data);
-    packet_t::base& operator >> (packet_t::base& p, impl_u64& data);
+        return (u << 24) | ((u << 8) & 0xff0000u) | ((u >> 8) & 0xff00u) | (u >> 24);
     #endif
+    }
 
-    template<typename T, typename enable = typename std::enable_if<std::is_enum<T>::value>::type>
-    packet_t::base& operator >> (packet_t::base& p, T& t) {
-        return p >> reinterpret_cast<typename std::underlying_type<T>::type&>(t);
+    inline std::uint64_t byte_swap(std::uint64_t u) {
+    #if defined(__GNUC__)
+        return __builtin_bswap64(u);
+    #else
+        return (std::uint64_t(byte_swap(std::uint32_t(u))) << 32) |
+            byte_swap(std::uint32_t(u >> 32));
+    #endif
     }
 
-    template<typename T, typename enable = typename std::enable_if<std::is_enum<T>::value>::type>
-    packet_t::base& operator << (packet_t::base& p, T t) {
-        return p << static_cast<typename std::underlying_type<T>::type>(t);
+    template<typename T>
+    using bulk_unsigned_type = typename std::make_unsigned<typename std::conditional<
+        std::is_enum<T>::value, std::underlying_type<T>, std::enable_if<true,T>
+    >::type::type>::type;
+
+    template<typename T>
+    void encode_bulk(const T* in, std::size_t n, char* out, std::false_type) {
+        // Big endian integers on a little endian host
+        using U = bulk_unsigned_type<T>;
+        for (std::size_t i = 0; i < n; ++i, out += sizeof(U)) {
+            U u = byte_swap(static_cast<U>(in[i]));
+            std::memcpy(out, &u, sizeof(U));
+        }
     }
 
-    packet_t::base& operator << (packet_t::base& o, ctl::empty_t);
-    packet_t::base& operator >> (packet_t::base& i, ctl::empty_t);
+    template<typename T>
+    void decode_bulk(const char* in, std::size_t n, T* out, std::true_type) {
+        std::memcpy(out, in, n*sizeof(T));
+    }
 
     template<typename T>
-    packet_t::base& operator >> (packet_t::base& p, std::vector<T>& t) {
-        std::uint32_t s;
-        p >> s;
+    void decode_bulk(const char* in, std::size_t n, T* out, std::false_type) {
+        using U = bulk_unsigned_type<T>;
+        for (std::size_t i = 0; i < n; ++i, in += sizeof(U)) {
+            U u;
+            std::memcpy(&u, in, sizeof(U));
+            out[i] = static_cast<T>(byte_swap(u));
+        }
+    }
+
+    /// Write all the elements of a container, one by one.
+    template<typename C>
+    void write_elements(packet_t::base& p, const C& t, std::false_type) {
+        for (auto& i : t) {
+            p << i;
+        }
+    }
+
+    /// Write all the elements of a contiguous container in bulk, with a single allocation.
+    template<typename C>
+    void write_elements(packet_t::base& p, const C& t, std::true_type) {
+        using T = typename C::value_type;
+        const std::size_t pos = p.size();
+        p.resize(pos + t.size()*sizeof(T));
+        encode_bulk(t.data(), t.size(), p.data() + pos, is_raw_bulk_type<T>{});
+    }
+
+    /// Read 'n' elements one by one, and store them starting at 't'.
+    template<typename P, typename T>
+    void read_elements(P& p, T* t, std::size_t n, std::false_type) {
+        for (std::size_t i : range(n)) {
+            p >> t[i];
+        }
+    }
+
+    /// Read 'n' elements in bulk, with a single bounds check.
+    template<typename P, typename T>
+    void read_elements(P& p, T* t, std::size_t n, std::true_type) {
+        if (const char* data = p.read(n*sizeof(T))) {
+            decode_bulk(data, n, t, is_raw_bulk_type<T>{});
+        }
+    }
+
+    template<typename P, typename T>
+    void read_vector(P& p, std::vector<T>& t, std::uint32_t s, std::false_type) {
         std::uint32_t i0 = t.size();
         t.resize(i0 + s);
         for (std::uint32_t i : range(s)) {
             p >> t[i0+i];
         }
-        return p;
+    }
+
+    template<typename P, typename T>
+    void read_vector(P& p, std::vector<T>& t, std::uint32_t s, std::true_type) {
+        // Check that the data is there before growing the vector
+        const char* data = p.read(std::size_t(s)*sizeof(T));
+        if (!data) return;
+
+        std::size_t i0 = t.size();
+        t.resize(i0 + s);
+        decode_bulk(data, s, t.data() + i0, is_raw_bulk_type<T>{});
+    }
+}
+
+template<typename T>
+packet_t::base& operator >> (packet_t::base& p, std::vector<T>& t) {
+    std::uint32_t s = 0;
+    p >> s;
+    packet_impl::read_vector(p, t, s, packet_impl::is_bulk_type<T>{});
+    return p;
+}
+
+template<typename T>
+packet_t::base& operator << (packet_t::base& p, const std::vector<T>& t) {
+    p << static_cast<std::uint32_t>(t.size());
+    packet_impl::write_elements(p, t, packet_impl::is_bulk_type<T>{});
+    return p;
+}
+
+template<typename T, typename C>
+packet_t::base& operator >> (packet_t::base& p, ctl::sorted_vector<T,C>& t) {
+    std::uint32_t s = 0; p >> s;
+    for (std::uint32_t i : range(s)) {
+        T tmp;
+        p >> tmp;
+        t.insert(std::move(tmp));
+    }
+    return p;
+}
+
+template<typename T, typename C>
+packet_t::base& operator << (packet_t::base& p, const ctl::sorted_vector<T,C>& t) {
+    p << static_cast<std::uint32_t>(t.size());
+    for (auto& i : t) {
+        p << i;
+    }
+    return p;
+}
+
+template<typename T, std::size_t N>
+packet_t::base& operator >> (packet_t::base& p, std::array<T,N>& t) {
+    packet_impl::read_elements(p, t.data(), N, packet_impl::is_bulk_type<T>{});
+    return p;
+}
+
+template<typename T, std::size_t N>
+packet_t::base& operator << (packet_t::base& p, const std::array<T,N>& t) {
+    packet_impl::write_elements(p, t, packet_impl::is_bulk_type<T>{});
+    return p;
+}
+
+template<typename T>
+packet_t::base& operator >> (packet_t::base& p, std::atomic<T>& t) {
+    T tmp; p >> tmp;
+    t = tmp;
+    return p;
+}
+
+template<typename T, typename C>
+packet_t::base& operator << (packet_t::base& p, const std::atomic<T>& t) {
+    p << t.load();
+    return p;
+}
+
+packet_t::base& operator << (packet_t::base& s, const color32& c);
+packet_t::base& operator >> (packet_t::base& s, color32& c);
+
+// Direct decoding of the above types from a serialized_packet_view
+serialized_packet_view& operator >> (serialized_packet_view& v, ctl::empty_t);
+serialized_packet_view& operator >> (serialized_packet_view& v, color32& c);
+
+template<typename T>
+serialized_packet_view& operator >> (serialized_packet_view& v, std::vector<T>& t) {
+    std::uint32_t s = 0;
+    if (!(v >> s)) return v;
+
+    packet_impl::read_vector(v, t, s, packet_impl::is_bulk_type<T>{});
+    return v;
+}
+
+template<typename T, typename C>
+serialized_packet_view& operator >> (serialized_packet_view& v, ctl::sorted_vector<T,C>& t) {
+    std::uint32_t s = 0;
+    if (!(v >> s)) return v;
+
+    for (std::uint32_t i : range(s)) {
+        T tmp;
+        v >> tmp;
+        t.insert(std::move(tmp));
+    }
+    return v;
+}
+
+template<typename T, std::size_t N>
+serialized_packet_view& operator >> (serialized_packet_view& v, std::array<T,N>& t) {
+    packet_impl::read_elements(v, t.data(), N, packet_impl::is_bulk_type<T>{});
+    return v;
+}
+
+template<typename T>
+serialized_packet_view& operator >> (serialized_packet_view& v, std::atomic<T>& t) {
+    T tmp; v >> tmp;
+    t = tmp;
+    return v;
+}
+
+namespace packet_impl {
+    /// Serialized size of the types that have no upper bound.
+    static constexpr std::size_t unbounded = std::size_t(-1);
+
+    /// Describe how values of type T are serialized, so that packets can be sized and
+    /// written in a single pass.
+    /** Specializations provide:
+         - supported(): true if the functions below are available,
+         - max_size(): the largest number of bytes written by operator <<, or unbounded.
+           Values of a bounded type are always written with exactly max_size() bytes,
+         - size(t): the exact number of bytes written by operator << for t,
+         - write(out, t): write t in 'out' as operator << would, and return the end of the
+           written data,
+         - read(in, t), for bounded types only: read t from 'in' as operator >> would, and
+           return the end of the read data.
+        refgen generates a specialization for each packet. The other types are written and
+        read with their operators, one by one.
+    **/
+    template<typename T, typename enable = void>
+    struct serialized {
+        static constexpr bool supported() { return false; }
+        static constexpr std::size_t max_size() { return unbounded; }
+    };
+
+    template<typename ... Args>
+    constexpr bool all_supported() {
+        return (serialized<Args>::supported() && ...);
     }
 
     template<typename T>
-    packet_t::base& operator << (packet_t::base& p, const std::vector<T>& t) {
-        p << static_cast<std::uint32_t>(t.size());
-        for (auto& i : t) {
-            p << i;
+    constexpr bool is_bounded() {
+        return serialized<T>::max_size() != unbounded;
+    }
+
+    constexpr std::size_t add_max_size(std::size_t s1, std::size_t s2) {
+        return s1 == unbounded || s2 == unbounded || s1 > unbounded - s2 ? unbounded : s1 + s2;
+    }
+
+    constexpr std::size_t multiply_max_size(std::size_t s, std::size_t n) {
+        return s == unbounded || (n != 0 && s > unbounded/n) ? unbounded : s*n;
+    }
+
+    /// Compute the maximum serialized size of a list of values.
+    template<typename ... Args>
+    constexpr std::size_t max_size_of() {
+        std::size_t s = 0;
+        for (std::size_t m : {std::size_t(0), serialized<Args>::max_size()...}) {
+            s = add_max_size(s, m);
         }
-        return p;
+
+        return s;
     }
 
+    /// Maximum serialized size of a value of type T, at compile time.
+    template<typename T>
+    constexpr std::size_t max_serialized_size = serialized<T>::max_size();
+
+    template<typename T>
+    struct serialized<T, typename std::enable_if<is_bulk_type<T>::value>::type> {
+        static constexpr bool supported() { return true; }
+        static constexpr std::size_t max_size() { return sizeof(T); }
+        static std::size_t size(const T&) { return sizeof(T); }
+
+        static char* write(char* out, const T& t) {
+            encode_bulk(&t, 1, out, is_raw_bulk_type<T>{});
+            return out + sizeof(T);
+        }
+
+        static const char* read(const char* in, T& t) {
+            decode_bulk(in, 1, &t, is_raw_bulk_type<T>{});
+            return in + sizeof(T);
+        }
+    };
+
+    template<>
+    struct serialized<bool> {
+        static constexpr bool supported() { return true; }
+        static constexpr std::size_t max_size() { return 1; }
+        static std::size_t size(bool) { return 1; }
+
+        static char* write(char* out, bool t) {
+            *out = t ? 1 : 0;
+            return out + 1;
+        }
+
+        static const char* read(const char* in, bool& t) {
+            t = *in != 0;
+            return in + 1;
+        }
+    };
+
+    template<>
+    struct serialized<ctl::empty_t> {
+        static constexpr bool supported() { return true; }
+        static constexpr std::size_t max_size() { return 0; }
+        static std::size_t size(ctl::empty_t) { return 0; }
+        static char* write(char* out, ctl::empty_t) { return out; }
+        static const char* read(const char* in, ctl::empty_t) { return in; }
+    };
+
+    template<>
+    struct serialized<std::string> {
+        static constexpr bool supported() { return true; }
+        static constexpr std::size_t max_size() { return unbounded; }
+
+        static std::size_t size(const std::string& t) {
+            return sizeof(std::uint32_t) + t.size();
+        }
+
+        static char* write(char* out, const std::string& t) {
+            out = serialized<std::uint32_t>::write(out, t.size());
+            std::memcpy(out, t.data(), t.size());
+            return out + t.size();
+        }
+    };
+
+    template<>
+    struct serialized<color32> {
+        static constexpr bool supported() { return true; }
+        static constexpr std::size_t max_size() { return 4; }
+
+        // Templates, since color32 is incomplete here
+        template<typename C>
+        static std::size_t size(const C&) { return 4; }
+
+        template<typename C>
+        static char* write(char* out, const C& c) {
+            out[0] = c.r; out[1] = c.g; out[2] = c.b; out[3] = c.a;
+            return out + 4;
+        }
+
+        template<typename C>
+        static const char* read(const char* in, C& c) {
+            c.r = in[0]; c.g = in[1]; c.b = in[2]; c.a = in[3];
+            return in + 4;
+        }
+    };
+
+    /// Size of the elements of a container, without the size prefix.
+    /** The element type 'T' is given explicitly, since some containers do not expose it
+        (ctl::sorted_vector hides the std::vector it is built upon).
+    **/
     template<typename T, typename C>
-    packet_t::base& operator >> (packet_t::base& p, ctl::sorted_vector<T,C>& t) {
-        std::uint32_t s; p >> s;
-        for (std::uint32_t i : range(s)) {
-            T tmp;
-            p >> tmp;
-            t.insert(std::move(tmp));
+    std::size_t elements_size(const C& t) {
+        if (is_bounded<T>()) {
+            return t.size()*serialized<T>::max_size();
+        }
+
+        std::size_t s = 0;
+        for (auto& i : t) {
+            s += serialized<T>::size(i);
         }
-        return p;
+
+        return s;
     }
 
     template<typename T, typename C>
-    packet_t::base& operator << (packet_t::base& p, const ctl::sorted_vector<T,C>& t) {
-        p << static_cast<std::uint32_t>(t.size());
+    char* write_elements(char* out, const C& t, std::false_type) {
         for (auto& i : t) {
-            p << i;
+            out = serialized<T>::write(out, i);
         }
-        return p;
+
+        return out;
     }
 
-    template<typename T, std::size_t N>
-    packet_t::base& operator >> (packet_t::base& p, std::array<T,N>& t) {
-        for (std::size_t i : range(N)) {
-            p >> t[i];
-        }
-        return p;
+    template<typename T, typename C>
+    char* write_elements(char* out, const C& t, std::true_type) {
+        encode_bulk(t.data(), t.size(), out, is_raw_bulk_type<T>{});
+        return out + t.size()*sizeof(T);
     }
 
+    template<typename T>
+    struct serialized<std::vector<T>> {
+        static constexpr bool supported() { return serialized<T>::supported(); }
+        static constexpr std::size_t max_size() { return unbounded; }
+
+        static std::size_t size(const std::vector<T>& t) {
+            return sizeof(std::uint32_t) + elements_size<T>(t);
+        }
+
+        static char* write(char* out, const std::vector<T>& t) {
+            out = serialized<std::uint32_t>::write(out, t.size());
+            return write_elements<T>(out, t, is_bulk_type<T>{});
+        }
+    };
+
+    template<typename T, typename C>
+    struct serialized<ctl::sorted_vector<T,C>> {
+        static constexpr bool supported() { return serialized<T>::supported(); }
+        static constexpr std::size_t max_size() { return unbounded; }
+
+        static std::size_t size(const ctl::sorted_vector<T,C>& t) {
+            return sizeof(std::uint32_t) + elements_size<T>(t);
+        }
+
+        static char* write(char* out, const ctl::sorted_vector<T,C>& t) {
+            out = serialized<std::uint32_t>::write(out, t.size());
+            return write_elements<T>(out, t, std::false_type{});
+        }
+    };
+
     template<typename T, std::size_t N>
-    packet_t::base& operator << (packet_t::base& p, const std::array<T,N>& t) {
-        for (auto& i : t) {
-            p << i;
+    struct serialized<std::array<T,N>> {
+        static constexpr bool supported() { return serialized<T>::supported(); }
+
+        static constexpr std::size_t max_size() {
+            return multiply_max_size(serialized<T>::max_size(), N);
+        }
+
+        static std::size_t size(const std::array<T,N>& t) {
+            return elements_size<T>(t);
+        }
+
+        static char* write(char* out, const std::array<T,N>& t) {
+            return write_elements<T>(out, t, is_bulk_type<T>{});
         }
-        return p;
-    }
+
+        static const char* read(const char* in, std::array<T,N>& t) {
+            for (auto& i : t) {
+                in = serialized<T>::read(in, i);
+            }
+
+            return in;
+        }
+    };
 
     template<typename T>
-    packet_t::base& operator >> (packet_t::base& p, std::atomic<T>& t) {
-        T tmp; p >> tmp;
-        t = tmp;
-        return p;
+    struct serialized<std::atomic<T>> {
+        static constexpr bool supported() { return serialized<T>::supported(); }
+        static constexpr std::size_t max_size() { return serialized<T>::max_size(); }
+
+        static std::size_t size(const std::atomic<T>& t) {
+            return serialized<T>::size(t.load());
+        }
+
+        static char* write(char* out, const std::atomic<T>& t) {
+            return serialized<T>::write(out, t.load());
+        }
+
+        static const char* read(const char* in, std::atomic<T>& t) {
+            T tmp;
+            in = serialized<T>::read(in, tmp);
+            t = tmp;
+            return in;
+        }
+    };
+
+    template<typename P, typename T>
+    bool read_fixed(P&, T&, std::false_type) {
+        return false;
     }
 
-    template<typename T, typename C>
-    packet_t::base& operator << (packet_t::base& p, const std::atomic<T>& t) {
-        p << t.load();
-        return p;
+    template<typename P, typename T>
+    bool read_fixed(P& p, T& t, std::true_type) {
+        if (const char* in = p.read(serialized<T>::max_size())) {
+            serialized<T>::read(in, t);
+        }
+
+        return true;
     }
 
-    packet_t::base& operator << (packet_t::base& s, const color32& c);
-    packet_t::base& operator >> (packet_t::base& s, color32& c);
+    /// Read a value of bounded size with a single bounds check.
+    /** \return false if T is not bounded, in which case nothing is read
+    **/
+    template<typename P, typename T>
+    bool read_fixed(P& p, T& t) {
+        return read_fixed(p, t, std::integral_constant<bool, is_bounded<T>()>{});
+    }
 }
 
 /// Physical type of a packet identifier.
@@ -178,6 +607,33 @@ void packet_write(P& p, T&& t, Args&& ... args) {
     packet_write(p, std::forward<Args>(args)...);
 }
 
+namespace packet_impl {
+    template<typename ... Args>
+    void write_exact(packet_t::base& p, std::false_type, const Args& ... args) {
+        packet_write(p, args...);
+    }
+
+    template<typename ... Args>
+    void write_exact(packet_t::base& p, std::true_type, const Args& ... args) {
+        const std::size_t pos = p.size();
+        p.resize(pos + (std::size_t(0) + ... + serialized<Args>::size(args)));
+
+        char* out = p.data() + pos;
+        ((out = serialized<Args>::write(out, args)), ...);
+    }
+}
+
+/// Write a list of objects into a packet, growing it only once.
+/** If all the objects have a serialized size that can be computed (see
+    packet_impl::serialized), the packet is resized to fit them exactly and they are all
+    encoded in a single pass. Otherwise, this is equivalent to packet_write().
+**/
+template<typename ... Args>
+void packet_write_exact(packet_t::base& p, const Args& ... args) {
+    packet_impl::write_exact(p, std::integral_constant<bool,
+        packet_impl::all_supported<Args...>()>{}, args...);
+}
+
 /// Read a list of objects from a packet.
 template<typename P>
 void packet_read(P& p) {}
@@ -0,0 +1,34 @@
+#ifndef PACKET_SOCKET_HPP
+#define PACKET_SOCKET_HPP
+
+#include <SFML/Network/TcpSocket.hpp>
+#include <serialized_packet.hpp>
+
+/// Send a packet through a TCP socket.
+/** The packet is preceded by its size (std::uint32_t, big endian), which is the same framing
+    as sf::TcpSocket::send(sf::Packet&).
+    \note The socket must be in blocking mode.
+**/
+sf::Socket::Status send_packet(sf::TcpSocket& socket, const serialized_packet& p);
+
+/// Receive packets from a TCP socket.
+/** Uses the same framing as sf::TcpSocket::receive(sf::Packet&). A packet that is only
+    partially received (e.g., on a non-blocking socket) is kept until the next call, so a
+    receiver must be used with a single socket. The data is received directly in the packet
+    buffer, which is allocated once when the size of the packet is known.
+**/
+class packet_receiver {
+    char header_[4];
+    std::size_t header_received_ = 0;
+    std::size_t expected_ = 0;
+    serialized_packet pending_;
+
+public :
+    /// Receive the next packet, or continue receiving it.
+    /** \return sf::Socket::Done once the whole packet is received, in which case it is moved
+                into 'p'; otherwise the status of the socket
+    **/
+    sf::Socket::Status receive(sf::TcpSocket& socket, serialized_packet& p);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include "packet_socket.hpp"
+#include <algorithm>
+#include <cstring>
+
+// Packets up to this size are sent with their header in a single call
+static const std::size_t small_packet_size = 1024;
+// Largest amount of memory allocated for a packet before its data is actually received
+static const std::size_t max_preallocated_size = 1 << 20;
+
+sf::Socket::Status send_packet(sf::TcpSocket& socket, const serialized_packet& p) {
+    const std::uint32_t s = p.size();
+    const char header[4] = {
+        char((s >> 24) & 0xff), char((s >> 16) & 0xff), char((s >> 8) & 0xff), char(s & 0xff)
+    };
+
+    if (s <= small_packet_size) {
+        char buffer[sizeof(header) + small_packet_size];
+        std::memcpy(buffer, header, sizeof(header));
+        std::memcpy(buffer + sizeof(header), p.data(), s);
+        return socket.send(buffer, sizeof(header) + s);
+    }
+
+    sf::Socket::Status status = socket.send(header, sizeof(header));
+    if (status != sf::Socket::Done) return status;
+    return socket.send(p.data(), s);
+}
+
+sf::Socket::Status packet_receiver::receive(sf::TcpSocket& socket, serialized_packet& p) {
+    if (header_received_ < sizeof(header_)) {
+        while (header_received_ < sizeof(header_)) {
+            std::size_t received = 0;
+            sf::Socket::Status status = socket.receive(header_ + header_received_,
+                sizeof(header_) - header_received_, received);
+            header_received_ += received;
+            if (status != sf::Socket::Done) return status;
+        }
+
+        expected_ = 0;
+        for (std::size_t i = 0; i < sizeof(header_); ++i) {
+            expected_ = (expected_ << 8) | static_cast<unsigned char>(header_[i]);
+        }
+
+        // Do not trust the size blindly, the buffer still grows as data is received
+        pending_.clear();
+        pending_.reserve(std::min(expected_, max_preallocated_size));
+    }
+
+    while (pending_.size() < expected_) {
+        const std::size_t pos = pending_.size();
+        const std::size_t chunk = std::min(expected_ - pos, max_preallocated_size);
+        pending_.resize(pos + chunk);
+
+        std::size_t received = 0;
+        sf::Socket::Status status = socket.receive(pending_.data() + pos, chunk, received);
+        pending_.resize(pos + received);
+        if (status != sf::Socket::Done) return status;
+    }
+
+    p = std::move(pending_);
+    header_received_ = 0;
+    return sf::Socket::Done;
+}
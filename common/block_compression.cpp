@@ -0,0 +1,361 @@
+#include "block_compression.hpp"
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace block_compression {
+    static const char magic[4] = {'C', 'B', 'C', '1'};
+
+    static const std::uint32_t stored_flag = 0x80000000u;
+
+    // Size of the stream header and of each block header
+    static const std::size_t header_size = 8;
+
+    // Minimum length of a match
+    static const std::size_t min_match = 4;
+    // The last bytes of a block are always literals
+    static const std::size_t last_literals = 5;
+    // A match cannot start closer than this from the end of a block
+    static const std::size_t match_limit = 12;
+    // Largest distance between a match and its reference
+    static const std::size_t max_offset = 65535;
+
+    static const std::size_t hash_bits = 14;
+
+    exception::exception(const std::string& msg) : std::runtime_error(msg) {}
+
+    static std::uint32_t read32(const char* p) {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static std::uint32_t hash32(std::uint32_t v) {
+        return (v*2654435761u) >> (32 - hash_bits);
+    }
+
+    static void put_u32(char* out, std::uint32_t v) {
+        for (std::size_t i = 0; i < 4; ++i) {
+            out[i] = char((v >> (8*i)) & 0xff);
+        }
+    }
+
+    static std::uint32_t get_u32(const char* in) {
+        std::uint32_t v = 0;
+        for (std::size_t i = 0; i < 4; ++i) {
+            v |= std::uint32_t(static_cast<unsigned char>(in[i])) << (8*i);
+        }
+
+        return v;
+    }
+
+    // Write the extra bytes of a length that does not fit in its 4 bits of the token
+    static char* write_length(char* op, std::size_t len) {
+        len -= 15;
+        while (len >= 255) {
+            *op++ = char(255);
+            len -= 255;
+        }
+
+        *op++ = char(len);
+        return op;
+    }
+
+    static char* write_sequence(char* op, const char* literals, std::size_t nliteral,
+        std::size_t offset, std::size_t match_length) {
+
+        char* token = op++;
+        unsigned char t = (std::min(nliteral, std::size_t(15)) << 4);
+        if (nliteral >= 15) op = write_length(op, nliteral);
+        // NB: the literals can be a null pointer for an empty block
+        if (nliteral != 0) std::memcpy(op, literals, nliteral);
+        op += nliteral;
+
+        if (match_length != 0) {
+            *op++ = char(offset & 0xff);
+            *op++ = char((offset >> 8) & 0xff);
+
+            std::size_t ml = match_length - min_match;
+            t |= std::min(ml, std::size_t(15));
+            if (ml >= 15) op = write_length(op, ml);
+        }
+
+        *token = char(t);
+        return op;
+    }
+
+    std::size_t max_compressed_size(std::size_t size) {
+        return size + size/255 + 16;
+    }
+
+    std::size_t compress_block(const char* in, std::size_t size, char* out) {
+        char* op = out;
+        std::size_t anchor = 0;
+
+        if (size > match_limit) {
+            std::vector<std::uint32_t> table(std::size_t(1) << hash_bits, 0);
+
+            const std::size_t ilimit = size - match_limit;
+            const std::size_t mlimit = size - last_literals;
+            std::size_t ip = 0;
+            while (ip < ilimit) {
+                std::uint32_t seq = read32(in + ip);
+                std::uint32_t& slot = table[hash32(seq)];
+                std::size_t ref = slot;
+                slot = ip;
+
+                if (ref >= ip || ip - ref > max_offset || read32(in + ref) != seq) {
+                    // Skip faster through data that does not compress
+                    ip += 1 + ((ip - anchor) >> 6);
+                    continue;
+                }
+
+                // Extend the match backward, then forward
+                while (ip > anchor && ref > 0 && in[ip-1] == in[ref-1]) {
+                    --ip;
+                    --ref;
+                }
+
+                std::size_t len = min_match;
+                while (ip + len < mlimit && in[ip+len] == in[ref+len]) {
+                    ++len;
+                }
+
+                op = write_sequence(op, in + anchor, ip - anchor, ip - ref, len);
+
+                ip += len;
+                anchor = ip;
+
+                if (ip < ilimit) {
+                    table[hash32(read32(in + ip - 2))] = ip - 2;
+                }
+            }
+        }
+
+        // Last literals
+        op = write_sequence(op, in + anchor, size - anchor, 0, 0);
+
+        return op - out;
+    }
+
+    // Read the extra bytes of a length
+    static bool read_length(const char*& ip, const char* iend, std::size_t& len) {
+        unsigned char b;
+        do {
+            if (ip == iend) return false;
+            b = static_cast<unsigned char>(*ip++);
+            len += b;
+        } while (b == 255);
+
+        return true;
+    }
+
+    bool decompress_block(const char* in, std::size_t size, char* out, std::size_t out_size) {
+        const char* ip = in;
+        const char* iend = in + size;
+        char* op = out;
+        char* oend = out + out_size;
+
+        while (ip != iend) {
+            unsigned char token = static_cast<unsigned char>(*ip++);
+
+            // Literals
+            std::size_t nliteral = token >> 4;
+            if (nliteral == 15 && !read_length(ip, iend, nliteral)) return false;
+            if (std::size_t(iend - ip) < nliteral || std::size_t(oend - op) < nliteral) {
+                return false;
+            }
+
+            if (nliteral != 0) std::memcpy(op, ip, nliteral);
+            ip += nliteral;
+            op += nliteral;
+
+            // The last sequence has no match
+            if (ip == iend) break;
+
+            // Match
+            if (iend - ip < 2) return false;
+            std::size_t offset = static_cast<unsigned char>(ip[0]) |
+                (std::size_t(static_cast<unsigned char>(ip[1])) << 8);
+            ip += 2;
+
+            if (offset == 0 || offset > std::size_t(op - out)) return false;
+
+            std::size_t len = token & 15;
+            if (len == 15 && !read_length(ip, iend, len)) return false;
+            len += min_match;
+            if (std::size_t(oend - op) < len) return false;
+
+            const char* ref = op - offset;
+            if (offset >= len) {
+                std::memcpy(op, ref, len);
+                op += len;
+            } else {
+                // Overlapping copy, the match repeats itself
+                for (std::size_t i = 0; i < len; ++i) {
+                    *op++ = *ref++;
+                }
+            }
+        }
+
+        return op == oend;
+    }
+
+    bool is_compressed(const char* data, std::size_t size) {
+        return size >= header_size && std::equal(std::begin(magic), std::end(magic), data);
+    }
+
+    std::vector<char> decompress(const char* data, std::size_t size) {
+        if (!is_compressed(data, size)) {
+            throw exception("not a compressed stream");
+        }
+
+        const std::size_t block_size = get_u32(data + 4);
+
+        // Find all the blocks first, which only reads their header
+        struct block {
+            const char* data;
+            std::size_t stored_size;
+            std::size_t raw_size;
+            std::size_t offset;
+            bool stored;
+        };
+
+        std::vector<block> blocks;
+        std::size_t total = 0;
+        std::size_t pos = header_size;
+        while (true) {
+            if (size - pos < header_size) {
+                throw exception("compressed stream is truncated");
+            }
+
+            std::size_t raw_size = get_u32(data + pos);
+            std::uint32_t stored_size = get_u32(data + pos + 4);
+            pos += header_size;
+
+            if (raw_size == 0) break;
+
+            bool stored = (stored_size & stored_flag) != 0;
+            stored_size &= ~stored_flag;
+            if (raw_size > block_size || (stored && stored_size != raw_size)) {
+                throw exception("invalid block size in compressed stream");
+            }
+
+            if (size - pos < stored_size) {
+                throw exception("compressed stream is truncated");
+            }
+
+            blocks.push_back({data + pos, stored_size, raw_size, total, stored});
+            total += raw_size;
+            pos += stored_size;
+        }
+
+        std::vector<char> result(total);
+
+        std::atomic<bool> valid(true);
+        tbb::parallel_for(tbb::blocked_range<std::size_t>(0, blocks.size()),
+            [&](const tbb::blocked_range<std::size_t>& r) {
+                for (std::size_t i = r.begin(); i != r.end(); ++i) {
+                    const block& b = blocks[i];
+                    if (b.stored) {
+                        std::memcpy(result.data() + b.offset, b.data, b.raw_size);
+                    } else if (!decompress_block(b.data, b.stored_size,
+                        result.data() + b.offset, b.raw_size)) {
+                        valid = false;
+                    }
+                }
+            }
+        );
+
+        if (!valid) {
+            throw exception("corrupted block in compressed stream");
+        }
+
+        return result;
+    }
+
+    output_buffer::output_buffer(std::ostream& out, std::size_t block_size) :
+        out_(out), block_size_(block_size), input_(block_size*blocks_per_batch),
+        output_(blocks_per_batch) {
+
+        char header[header_size];
+        std::copy(std::begin(magic), std::end(magic), header);
+        put_u32(header + 4, block_size_);
+        out_.write(header, header_size);
+
+        setp(input_.data(), input_.data() + input_.size());
+    }
+
+    output_buffer::~output_buffer() {
+        finish();
+    }
+
+    void output_buffer::compress_input() {
+        const std::size_t size = pptr() - pbase();
+        if (size == 0) return;
+
+        const std::size_t nblock = (size + block_size_ - 1)/block_size_;
+        tbb::parallel_for(tbb::blocked_range<std::size_t>(0, nblock, 1),
+            [&](const tbb::blocked_range<std::size_t>& r) {
+                for (std::size_t i = r.begin(); i != r.end(); ++i) {
+                    const char* in = input_.data() + i*block_size_;
+                    const std::size_t raw_size = std::min(block_size_, size - i*block_size_);
+
+                    std::vector<char>& out = output_[i];
+                    out.resize(header_size + max_compressed_size(raw_size));
+
+                    std::size_t stored_size = compress_block(in, raw_size, out.data() + header_size);
+                    if (stored_size >= raw_size) {
+                        // Not worth it
+                        std::memcpy(out.data() + header_size, in, raw_size);
+                        stored_size = raw_size;
+                        put_u32(out.data() + 4, stored_size | stored_flag);
+                    } else {
+                        put_u32(out.data() + 4, stored_size);
+                    }
+
+                    put_u32(out.data(), raw_size);
+                    out.resize(header_size + stored_size);
+                }
+            }
+        );
+
+        for (std::size_t i = 0; i < nblock; ++i) {
+            out_.write(output_[i].data(), output_[i].size());
+        }
+
+        setp(input_.data(), input_.data() + input_.size());
+    }
+
+    output_buffer::int_type output_buffer::overflow(int_type c) {
+        if (finished_) return traits_type::eof();
+
+        compress_input();
+
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+
+        return traits_type::not_eof(c);
+    }
+
+    int output_buffer::sync() {
+        // Only compress full blocks, so that flushing does not degrade compression
+        return 0;
+    }
+
+    void output_buffer::finish() {
+        if (finished_) return;
+
+        compress_input();
+        finished_ = true;
+        setp(nullptr, nullptr);
+
+        char end[header_size] = {0};
+        out_.write(end, header_size);
+        out_.flush();
+    }
+}
@@ -1,5 +1,99 @@
 #include "crc32.hpp"
+#include <array>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CRC32C_SSE42
+#include <nmmintrin.h>
+#endif
 
 std::uint32_t get_crc32(const std::string& str) {
     return recursive_crc32(0, str.c_str(), 0, str.size(), 0, 0x4C11DB7);
 }
+
+namespace crc32_impl {
+    // Reversed Castagnoli polynomial
+    static const std::uint32_t poly = 0x82F63B78u;
+
+    using table_t = std::array<std::array<std::uint32_t,256>,8>;
+
+    static table_t make_tables() {
+        table_t t;
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t c = i;
+            for (std::size_t j = 0; j < 8; ++j) {
+                c = (c & 1) ? (c >> 1) ^ poly : c >> 1;
+            }
+
+            t[0][i] = c;
+        }
+
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            for (std::size_t k = 1; k < 8; ++k) {
+                t[k][i] = (t[k-1][i] >> 8) ^ t[0][t[k-1][i] & 0xff];
+            }
+        }
+
+        return t;
+    }
+
+    static std::uint32_t read32(const unsigned char* p) {
+        return std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) |
+            (std::uint32_t(p[2]) << 16) | (std::uint32_t(p[3]) << 24);
+    }
+
+    static std::uint32_t slice8(const unsigned char* p, std::size_t n, std::uint32_t crc) {
+        static const table_t t = make_tables();
+
+        for (; n >= 8; n -= 8, p += 8) {
+            std::uint32_t one = read32(p) ^ crc;
+            std::uint32_t two = read32(p + 4);
+            crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^
+                  t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^
+                  t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^
+                  t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+        }
+
+        for (; n != 0; --n, ++p) {
+            crc = t[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+        }
+
+        return crc;
+    }
+
+#ifdef CRC32C_SSE42
+    __attribute__((target("sse4.2")))
+    static std::uint32_t sse42(const unsigned char* p, std::size_t n, std::uint32_t crc) {
+        std::uint64_t c = crc;
+        for (; n >= 8; n -= 8, p += 8) {
+            std::uint64_t v;
+            __builtin_memcpy(&v, p, sizeof(v));
+            c = _mm_crc32_u64(c, v);
+        }
+
+        crc = std::uint32_t(c);
+        for (; n != 0; --n, ++p) {
+            crc = _mm_crc32_u8(crc, *p);
+        }
+
+        return crc;
+    }
+
+    static bool has_sse42() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2");
+    }
+#endif
+}
+
+std::uint32_t crc32c(const void* data, std::size_t size, std::uint32_t crc) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+
+#ifdef CRC32C_SSE42
+    static const bool hardware = crc32_impl::has_sse42();
+    if (hardware) {
+        return ~crc32_impl::sse42(p, size, ~crc);
+    }
+#endif
+
+    return ~crc32_impl::slice8(p, size, ~crc);
+}
@@ -6,11 +6,14 @@
 #include <fnmatch.h>
 #include <ftw.h>
 #include <dlfcn.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <cstring>
 #include <cstdio>
 #include <ctime>
 #include <iostream>
 #include <fstream>
+#include <utility>
 
 namespace file {
     namespace impl {
@@ -273,3 +276,52 @@ void* shared_library::load_symbol(const std::string& sym) {
 }
 
 const std::string shared_library::file_extension = "so";
+
+mapped_file::mapped_file(const std::string& file) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            data_ = static_cast<const char*>(data);
+            size_ = st.st_size;
+            handle_ = data;
+        }
+    }
+
+    // The mapping keeps a reference to the file
+    ::close(fd);
+}
+
+mapped_file::~mapped_file() {
+    if (handle_) {
+        ::munmap(handle_, size_);
+    }
+}
+
+mapped_file::mapped_file(mapped_file&& m) : data_(m.data_), size_(m.size_), handle_(m.handle_) {
+    m.data_ = nullptr;
+    m.size_ = 0;
+    m.handle_ = nullptr;
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& m) {
+    std::swap(data_, m.data_);
+    std::swap(size_, m.size_);
+    std::swap(handle_, m.handle_);
+    return *this;
+}
+
+bool mapped_file::open() const {
+    return handle_ != nullptr;
+}
+
+const char* mapped_file::data() const {
+    return data_;
+}
+
+std::size_t mapped_file::size() const {
+    return size_;
+}
@@ -150,3 +150,58 @@ void* shared_library::load_symbol(const std::string& sym) {
 }
 
 const std::string shared_library::file_extension = "dll";
+
+mapped_file::mapped_file(const std::string& file) {
+    HANDLE fh = CreateFile(file.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, 0);
+    if (fh == INVALID_HANDLE_VALUE) return;
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(fh, &size) && size.QuadPart > 0) {
+        HANDLE mh = CreateFileMapping(fh, 0, PAGE_READONLY, 0, 0, 0);
+        if (mh) {
+            void* data = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+            if (data) {
+                data_ = static_cast<const char*>(data);
+                size_ = size.QuadPart;
+                handle_ = data;
+            }
+
+            // The view keeps a reference to the mapping
+            CloseHandle(mh);
+        }
+    }
+
+    CloseHandle(fh);
+}
+
+mapped_file::~mapped_file() {
+    if (handle_) {
+        UnmapViewOfFile(handle_);
+    }
+}
+
+mapped_file::mapped_file(mapped_file&& m) : data_(m.data_), size_(m.size_), handle_(m.handle_) {
+    m.data_ = nullptr;
+    m.size_ = 0;
+    m.handle_ = nullptr;
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& m) {
+    std::swap(data_, m.data_);
+    std::swap(size_, m.size_);
+    std::swap(handle_, m.handle_);
+    return *this;
+}
+
+bool mapped_file::open() const {
+    return handle_ != nullptr;
+}
+
+const char* mapped_file::data() const {
+    return data_;
+}
+
+std::size_t mapped_file::size() const {
+    return size_;
+}
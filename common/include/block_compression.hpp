@@ -0,0 +1,99 @@
+#ifndef BLOCK_COMPRESSION_HPP
+#define BLOCK_COMPRESSION_HPP
+
+#include <streambuf>
+#include <ostream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+
+/// Fast LZ compression of data split in independent blocks.
+/** Each block is compressed with a byte-oriented LZ77 codec (same sequence layout as the
+    LZ4 block format), which favors speed over compression ratio. Since blocks are
+    independent, they are compressed and decompressed in parallel.
+
+    A compressed stream is made of:
+     - a 4 byte magic number followed by the block size (little endian std::uint32_t),
+     - for each block, its uncompressed size and its stored size (little endian
+       std::uint32_t), followed by the stored data. If the highest bit of the stored size is
+       set, the block could not be compressed and is stored as is,
+     - an end marker, i.e., a block of uncompressed size zero.
+**/
+namespace block_compression {
+    /// Default size of the blocks, before compression.
+    static constexpr std::size_t default_block_size = 1 << 20;
+
+    struct exception : std::runtime_error {
+        explicit exception(const std::string& msg);
+    };
+
+    /// Return the largest possible size of 'size' bytes once compressed.
+    std::size_t max_compressed_size(std::size_t size);
+
+    /// Compress a single block.
+    /** \param out A buffer that can hold at least max_compressed_size(size) bytes
+        \return The number of bytes written to 'out'
+    **/
+    std::size_t compress_block(const char* in, std::size_t size, char* out);
+
+    /// Decompress a single block.
+    /** \return false if the compressed data is invalid, or does not decompress to exactly
+                'out_size' bytes
+        \note This never reads or writes outside of the provided buffers.
+    **/
+    bool decompress_block(const char* in, std::size_t size, char* out, std::size_t out_size);
+
+    /// Check if the provided data starts like a compressed stream.
+    bool is_compressed(const char* data, std::size_t size);
+
+    /// Decompress a whole compressed stream.
+    /** The blocks are decompressed in parallel.
+        \throw exception if the data is not a valid compressed stream
+    **/
+    std::vector<char> decompress(const char* data, std::size_t size);
+
+    /// Stream buffer that compresses everything written to it, and writes it to another stream.
+    /** Data is accumulated until a few blocks are filled, then these are compressed in
+        parallel and written to the output stream. Use it to compress any std::ostream:
+
+        \code{.cpp}
+            std::ofstream file("data.bin", std::ios::binary);
+            block_compression::output_buffer buffer(file);
+            std::ostream out(&buffer);
+            out << ...;
+        \endcode
+
+        \note The end marker is written by finish(), or when the buffer is destroyed.
+    **/
+    class output_buffer : public std::streambuf {
+        std::ostream& out_;
+        std::size_t block_size_;
+        std::vector<char> input_;
+        std::vector<std::vector<char>> output_;
+        bool finished_ = false;
+
+        void compress_input();
+
+    protected :
+        int_type overflow(int_type c) override;
+        int sync() override;
+
+    public :
+        /// Number of blocks that are compressed together.
+        static constexpr std::size_t blocks_per_batch = 8;
+
+        explicit output_buffer(std::ostream& out, std::size_t block_size = default_block_size);
+        ~output_buffer() override;
+
+        output_buffer(const output_buffer&) = delete;
+        output_buffer& operator = (const output_buffer&) = delete;
+
+        /// Compress and write any pending data, then write the end marker.
+        /** \note No data can be written after this call.
+        **/
+        void finish();
+    };
+}
+
+#endif
@@ -17,6 +17,14 @@ constexpr std::uint32_t recursive_crc32(std::uint32_t id, const char* str, std::
 
 std::uint32_t get_crc32(const std::string& str);
 
+/// Compute the CRC-32C (Castagnoli) checksum of a buffer.
+/** Unlike get_crc32(), which is meant for short strings, this is designed for throughput on
+    large buffers. It uses the SSE4.2 crc32 instruction when the CPU supports it, and a
+    slice-by-8 table-driven implementation otherwise. Both give the same result.
+    To checksum data in several pieces, pass the result of the previous call as 'crc'.
+**/
+std::uint32_t crc32c(const void* data, std::size_t size, std::uint32_t crc = 0);
+
 constexpr std::uint32_t operator "" _crc32(const char* str, std::size_t length) {
     return recursive_crc32(0, str, 0, length, 0, 0x4C11DB7);
 }
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <cstddef>
 
 namespace sf {
     class Packet;
@@ -33,6 +34,31 @@ public :
     static const std::string file_extension;
 };
 
+/// Read-only view of the whole content of a file, mapped in memory.
+/** The pages of the file are only read from the disk when they are first accessed, so a
+    small part of a large file can be read without reading the rest.
+**/
+class mapped_file {
+private :
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    void* handle_ = nullptr;
+public :
+    mapped_file() = default;
+    explicit mapped_file(const std::string& file);
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    mapped_file(mapped_file&&);
+    mapped_file& operator=(mapped_file&&);
+
+    bool open() const;
+    const char* data() const;
+    std::size_t size() const;
+};
+
 namespace file {
     bool exists(const std::string& file);
     std::vector<std::string> list_directories(const std::string& path = "");
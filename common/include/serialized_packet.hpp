@@ -1,70 +1,204 @@
 #ifndef SERIALIZED_PACKET_HPP
 #define SERIALIZED_PACKET_HPP
 
-#include <SFML/Network/Packet.hpp>
 #include <variadic.hpp>
+#include <vector>
+#include <string>
+#include <memory>
+#include <iosfwd>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
 
-namespace rob_impl {
-    // Robery to expose private members of sf::Packet
-    // Adapted from:
-    // http://bloglitb.blogspot.fr/2010/07/access-to-private-members-thats-easy.html
-    // https://gist.github.com/dabrahams/1528856
+struct serialized_packet_view;
 
-    template<typename T>
-    struct stolen {
-        static typename T::type ptr;
-    };
+/// Growable buffer of serialized data.
+/** The encoding is the same as that of sf::Packet: integers are stored in big endian,
+    floating point numbers in their native representation, and strings are preceded by their
+    length (std::uint32_t). Packets are sent over the network with the same framing as
+    sf::TcpSocket (see packet_socket.hpp), so the wire format is unchanged.
 
-    template<typename T>
-    typename T::type stolen<T>::ptr;
+    Small packets are stored inside the object itself, and only allocate memory once they
+    grow beyond inline_capacity bytes. Larger buffers grow geometrically, and can be
+    allocated up front with reserve().
+**/
+class serialized_packet {
+public :
+    /// Number of bytes that can be stored without allocating memory.
+    static constexpr std::size_t inline_capacity = 64;
 
-    template<typename T, typename T::type P>
-    struct rob {
-        rob() {
-            stolen<T>::ptr = P;
-        }
+private :
+    std::unique_ptr<char[]> heap_;
+    std::size_t size_ = 0;
+    std::size_t capacity_ = inline_capacity;
+    std::size_t read_pos_ = 0;
+    bool valid_ = true;
+    char inline_[inline_capacity];
 
-        static rob robbed;
-    };
+    void reset_();
 
-    template<typename T, typename T::type P>
-    rob<T,P> rob<T,P>::robbed;
+    char* write_(std::size_t size) {
+        if (capacity_ - size_ < size) {
+            reserve(std::max(2*capacity_, size_ + size));
+        }
 
-    struct sf_packet_read_pos {
-        using type = std::size_t (sf::Packet::*);
-    };
+        char* p = data() + size_;
+        size_ += size;
+        return p;
+    }
 
-    template struct rob<sf_packet_read_pos, &sf::Packet::m_readPos>;
-}
+    template<typename T>
+    void write_integer_(T t) {
+        using U = typename std::make_unsigned<T>::type;
+        U u = static_cast<U>(t);
+        char* p = write_(sizeof(T));
+        for (std::size_t i = sizeof(T); i != 0; --i) {
+            p[i-1] = char(u & 0xff);
+            u = U(u >> 8);
+        }
+    }
 
-struct serialized_packet_view;
+    template<typename T>
+    void read_integer_(T& t) {
+        using U = typename std::make_unsigned<T>::type;
+        if (const char* p = read(sizeof(T))) {
+            U u = 0;
+            for (std::size_t i = 0; i < sizeof(T); ++i) {
+                u = U(u << 8) | static_cast<unsigned char>(p[i]);
+            }
+
+            t = static_cast<T>(u);
+        }
+    }
 
-class serialized_packet : public sf::Packet {
-    std::size_t* read_pos_;
+    template<typename T>
+    void write_raw_(T t) {
+        std::memcpy(write_(sizeof(T)), &t, sizeof(T));
+    }
 
-    typedef bool (Packet::*BoolType)(std::size_t);
-    operator BoolType() = delete;
+    template<typename T>
+    void read_raw_(T& t) {
+        if (const char* p = read(sizeof(T))) {
+            std::memcpy(&t, p, sizeof(T));
+        }
+    }
 
 public :
-    using base = sf::Packet;
+    /// Type for which the serialization operators of custom types are written.
+    using base = serialized_packet;
 
-    serialized_packet();
+    serialized_packet() = default;
     serialized_packet(const serialized_packet& p);
-    serialized_packet(serialized_packet&& p);
-    serialized_packet(const sf::Packet& p);
-    serialized_packet(sf::Packet&& p);
+    serialized_packet(serialized_packet&& p) noexcept;
 
     serialized_packet& operator = (const serialized_packet& p);
-    serialized_packet& operator = (serialized_packet&& p);
-    serialized_packet& operator = (const sf::Packet& p);
-    serialized_packet& operator = (sf::Packet&& p);
+    serialized_packet& operator = (serialized_packet&& p) noexcept;
+
+    /// Return a pointer to the beginning of the data.
+    char* data() {
+        return heap_ ? heap_.get() : inline_;
+    }
+
+    const char* data() const {
+        return heap_ ? heap_.get() : inline_;
+    }
+
+    /// Return the size of the data, in bytes.
+    std::size_t size() const {
+        return size_;
+    }
+
+    /// Return the number of bytes that can be stored before allocating memory.
+    std::size_t capacity() const {
+        return capacity_;
+    }
+
+    /// Make sure that at least 'capacity' bytes can be stored without allocating memory.
+    void reserve(std::size_t capacity);
+
+    /// Change the size of the data.
+    /** New bytes are left uninitialized, to be filled through data().
+    **/
+    void resize(std::size_t size);
+
+    /// Append raw data at the end of the packet.
+    void append(const void* data, std::size_t size) {
+        if (size != 0) std::memcpy(write_(size), data, size);
+    }
+
+    /// Remove all the data, and reset the read position and validity.
+    /** \note This does not release the memory.
+    **/
+    void clear();
 
-    std::size_t tellg() const;
-    void seekg(std::size_t pos);
+    /// Take ownership of an external buffer, and use its content as the packet data.
+    /** \param buffer The new buffer, allocated with new char[capacity]
+        \param size The number of bytes of data already stored in the buffer
+        \param capacity The size of the buffer, which must be at least 'size'
+        \note The read position and validity are reset.
+    **/
+    void adopt(std::unique_ptr<char[]> buffer, std::size_t size, std::size_t capacity);
+
+    std::size_t tellg() const {
+        return read_pos_;
+    }
+
+    void seekg(std::size_t pos) {
+        read_pos_ = pos;
+    }
+
+    bool end_of_packet() const {
+        return read_pos_ >= size_;
+    }
+
+    /// Return a pointer to the next 'size' bytes and skip them, or nullptr if there are less.
+    /** \note Once a read has failed, all the following reads fail too.
+    **/
+    const char* read(std::size_t size) {
+        if (!valid_ || size > size_ - std::min(read_pos_, size_)) {
+            valid_ = false;
+            return nullptr;
+        }
+
+        const char* p = data() + read_pos_;
+        read_pos_ += size;
+        return p;
+    }
 
     serialized_packet_view view() const;
 
-    explicit operator bool();
+    /// Return false if a previous read went past the end of the data.
+    explicit operator bool() const {
+        return valid_;
+    }
+
+    serialized_packet& operator << (bool t)               { write_integer_(std::uint8_t(t ? 1 : 0)); return *this; }
+    serialized_packet& operator << (std::int8_t t)        { write_integer_(t); return *this; }
+    serialized_packet& operator << (std::uint8_t t)       { write_integer_(t); return *this; }
+    serialized_packet& operator << (std::int16_t t)       { write_integer_(t); return *this; }
+    serialized_packet& operator << (std::uint16_t t)      { write_integer_(t); return *this; }
+    serialized_packet& operator << (std::int32_t t)       { write_integer_(t); return *this; }
+    serialized_packet& operator << (std::uint32_t t)      { write_integer_(t); return *this; }
+    serialized_packet& operator << (std::int64_t t)       { write_integer_(t); return *this; }
+    serialized_packet& operator << (std::uint64_t t)      { write_integer_(t); return *this; }
+    serialized_packet& operator << (float t)              { write_raw_(t); return *this; }
+    serialized_packet& operator << (double t)             { write_raw_(t); return *this; }
+    serialized_packet& operator << (const char* t);
+    serialized_packet& operator << (const std::string& t);
+
+    serialized_packet& operator >> (bool& t);
+    serialized_packet& operator >> (std::int8_t& t)       { read_integer_(t); return *this; }
+    serialized_packet& operator >> (std::uint8_t& t)      { read_integer_(t); return *this; }
+    serialized_packet& operator >> (std::int16_t& t)      { read_integer_(t); return *this; }
+    serialized_packet& operator >> (std::uint16_t& t)     { read_integer_(t); return *this; }
+    serialized_packet& operator >> (std::int32_t& t)      { read_integer_(t); return *this; }
+    serialized_packet& operator >> (std::uint32_t& t)     { read_integer_(t); return *this; }
+    serialized_packet& operator >> (std::int64_t& t)      { read_integer_(t); return *this; }
+    serialized_packet& operator >> (std::uint64_t& t)     { read_integer_(t); return *this; }
+    serialized_packet& operator >> (float& t)             { read_raw_(t); return *this; }
+    serialized_packet& operator >> (double& t)            { read_raw_(t); return *this; }
+    serialized_packet& operator >> (std::string& t);
 };
 
 using packet_t = serialized_packet;
@@ -75,43 +209,178 @@ serialized_packet& operator >> (serialized_packet& p, serialized_packet& op);
 std::istream& operator >> (std::istream& in, serialized_packet& p);
 std::ostream& operator << (std::ostream& in, const serialized_packet& path);
 
-template<typename T, typename enable =
-    typename std::enable_if<!std::is_same<T,serialized_packet>::value>::type>
-serialized_packet& operator << (serialized_packet& p, T&& t) {
-    serialized_packet::base& bp = p;
-    bp << std::forward<T>(t);
-    return p;
-}
+/// Writes length-prefixed packets to a stream, through a large reusable buffer.
+/** The output is identical to writing each packet with operator<<(std::ostream&), but the
+    packets are accumulated in a single buffer that is only flushed to the stream when it is
+    full, and no temporary packet is created for the size prefix.
+**/
+class serialized_packet_writer {
+    std::ostream& out_;
+    std::vector<char> buffer_;
+    std::size_t chunk_size_;
+    std::size_t written_ = 0;
 
-template<typename T, typename enable =
-    typename std::enable_if<!std::is_same<T,serialized_packet>::value>::type>
-serialized_packet& operator >> (serialized_packet& p, T&& t) {
-    serialized_packet::base& bp = p;
-    bp >> std::forward<T>(t);
-    return p;
-}
+public :
+    /// Default size of the buffer, in bytes.
+    static constexpr std::size_t default_chunk_size = 1 << 20;
+
+    explicit serialized_packet_writer(std::ostream& out,
+        std::size_t chunk_size = default_chunk_size);
+    ~serialized_packet_writer();
+
+    serialized_packet_writer(const serialized_packet_writer&) = delete;
+    serialized_packet_writer& operator = (const serialized_packet_writer&) = delete;
+
+    /// Write a packet, preceded by its size.
+    void write(const serialized_packet& p);
+
+    /// Write raw data, preceded by its size.
+    void write(const void* data, std::size_t size);
+
+    /// Write raw data, without size prefix.
+    void write_raw(const void* data, std::size_t size);
+
+    /// Write the content of the buffer to the stream.
+    /** \note This is done automatically when the buffer is full, and when the writer is
+              destroyed.
+    **/
+    void flush();
+
+    /// Return the total number of bytes written so far, including those still in the buffer.
+    std::size_t bytes_written() const;
+};
 
+serialized_packet_writer& operator << (serialized_packet_writer& w, const serialized_packet& p);
+
+/// Read-only cursor over the content of a packet.
+/** The view has its own read position and never modifies the packet, so several views can
+    read the same packet concurrently, from different threads. Values are decoded directly
+    from the packet's memory, with the same encoding as serialized_packet (integers in big
+    endian). Types that have no dedicated operator for the view are decoded through their
+    serialized_packet operator, from a private copy of the remaining data.
+    \note The view points to the data of the packet, and becomes invalid if the packet is
+          modified or destroyed.
+**/
 struct serialized_packet_view {
     serialized_packet_view() = default;
     serialized_packet_view(const serialized_packet& p);
+    serialized_packet_view(const void* data, std::size_t size);
+
+    std::size_t tellg() const {
+        return read_pos_;
+    }
+
+    void seekg(std::size_t pos) {
+        read_pos_ = pos;
+    }
+
+    /// Return a pointer to the beginning of the viewed data.
+    const char* data() const {
+        return data_;
+    }
+
+    /// Return the size of the viewed data, in bytes.
+    std::size_t size() const {
+        return size_;
+    }
+
+    bool end_of_packet() const {
+        return read_pos_ >= size_;
+    }
+
+    /// Return false if a previous read went past the end of the data.
+    explicit operator bool() const {
+        return valid_;
+    }
+
+    /// Return a pointer to the next 'size' bytes and skip them, or nullptr if there are less.
+    /** \note Once a read has failed, all the following reads fail too.
+    **/
+    const char* read(std::size_t size) {
+        if (!valid_ || size > size_ - std::min(read_pos_, size_)) {
+            valid_ = false;
+            return nullptr;
+        }
 
-    std::size_t tellg() const;
-    void seekg(std::size_t pos);
+        const char* p = data_ + read_pos_;
+        read_pos_ += size;
+        return p;
+    }
+
+    /// Mark the view as invalid, as if a read had failed.
+    void invalidate() {
+        valid_ = false;
+    }
 
+    /// Allows reading from a temporary view, e.g., p.view() >> t.
     template<typename T>
-    serialized_packet_view& operator >> (T& t) {
-        serialized_packet& p = const_cast<serialized_packet&>(*packet_);
-        std::size_t opos = p.tellg();
-        p.seekg(read_pos_);
-        p >> t;
-        read_pos_ = p.tellg();
-        p.seekg(opos);
-        return *this;
+    serialized_packet_view& operator >> (T& t) && {
+        return static_cast<serialized_packet_view&>(*this) >> t;
     }
 
 private :
-    const serialized_packet* packet_ = nullptr;
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
     std::size_t read_pos_ = 0;
+    bool valid_ = true;
 };
 
+template<typename T, typename enable = typename std::enable_if<
+    std::is_integral<T>::value && !std::is_same<T,bool>::value>::type>
+serialized_packet_view& operator >> (serialized_packet_view& v, T& t) {
+    // Big endian, as serialized_packet
+    using U = typename std::make_unsigned<T>::type;
+    if (const char* p = v.read(sizeof(T))) {
+        U u = 0;
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            u = U(u << 8) | static_cast<unsigned char>(p[i]);
+        }
+
+        t = static_cast<T>(u);
+    }
+
+    return v;
+}
+
+template<typename T, typename enable = typename std::enable_if<
+    std::is_floating_point<T>::value>::type, typename enable2 = void>
+serialized_packet_view& operator >> (serialized_packet_view& v, T& t) {
+    // Native representation, as serialized_packet
+    if (const char* p = v.read(sizeof(T))) {
+        std::memcpy(&t, p, sizeof(T));
+    }
+
+    return v;
+}
+
+template<typename T, typename enable = typename std::enable_if<
+    std::is_enum<T>::value>::type, typename enable2 = void, typename enable3 = void>
+serialized_packet_view& operator >> (serialized_packet_view& v, T& t) {
+    typename std::underlying_type<T>::type u;
+    if (v >> u) t = static_cast<T>(u);
+    return v;
+}
+
+serialized_packet_view& operator >> (serialized_packet_view& v, bool& t);
+serialized_packet_view& operator >> (serialized_packet_view& v, std::string& t);
+
+template<typename T, typename enable = typename std::enable_if<
+    !std::is_arithmetic<T>::value && !std::is_enum<T>::value>::type,
+    typename enable2 = void, typename enable3 = void, typename enable4 = void>
+serialized_packet_view& operator >> (serialized_packet_view& v, T& t) {
+    // No direct decoding for this type, decode it from a copy of the remaining data
+    const std::size_t pos = std::min(v.tellg(), v.size());
+    serialized_packet p;
+    p.append(v.data() + pos, v.size() - pos);
+    p >> t;
+
+    if (!p) {
+        v.invalidate();
+    } else {
+        v.read(p.tellg());
+    }
+
+    return v;
+}
+
 #endif
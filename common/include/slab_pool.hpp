@@ -0,0 +1,119 @@
+#ifndef SLAB_POOL_HPP
+#define SLAB_POOL_HPP
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+
+namespace ctl {
+    /// Fixed size block allocator.
+    /** This class hands out uninitialized memory blocks that are large enough to hold an object
+        of type T. The blocks are carved out of large contiguous slabs, which are allocated with
+        a geometrically increasing size (up to max_slab_size bytes), so that allocating N blocks
+        only costs O(log(N)) calls to the system allocator. Blocks that are given back to the
+        pool are kept in a free-list, and are reused by the next calls to allocate(). The memory
+        of the slabs is only returned to the system when the pool is destroyed, or when
+        release() is called.
+
+        Neither this class nor its blocks know anything about the objects they contain: it is
+        the responsibility of the user to construct objects in the returned memory (placement
+        new), and to call their destructor before calling deallocate(). In return, tearing down
+        a large number of objects is as cheap as calling their destructors, since the memory
+        itself is released in a handful of slab deallocations.
+
+        This class is not thread safe.
+    **/
+    template<typename T>
+    class slab_pool {
+        union node {
+            node* next;
+            alignas(T) unsigned char storage[sizeof(T)];
+        };
+
+        std::vector<std::unique_ptr<node[]>> slabs_;
+        node* free_ = nullptr;
+        node* next_ = nullptr;
+        node* end_ = nullptr;
+        std::size_t capacity_ = 0;
+        std::size_t live_ = 0;
+
+        void grow_() {
+            std::size_t n = slabs_.empty() ? min_slab_blocks :
+                std::min(2*capacity_, max_slab_blocks);
+            n = std::max(n, std::size_t(1));
+
+            slabs_.emplace_back(new node[n]);
+            next_ = slabs_.back().get();
+            end_ = next_ + n;
+            capacity_ += n;
+        }
+
+    public :
+        /// Number of blocks in the first slab.
+        static constexpr std::size_t min_slab_blocks = 16;
+        /// Maximum size of a slab, in bytes.
+        static constexpr std::size_t max_slab_size = 1 << 20;
+        /// Maximum number of blocks in a slab.
+        static constexpr std::size_t max_slab_blocks = max_slab_size/sizeof(node) > min_slab_blocks ?
+            max_slab_size/sizeof(node) : min_slab_blocks;
+
+        slab_pool() = default;
+        slab_pool(const slab_pool&) = delete;
+        slab_pool& operator = (const slab_pool&) = delete;
+        slab_pool(slab_pool&&) = default;
+        slab_pool& operator = (slab_pool&&) = default;
+
+        /// Return an uninitialized block of memory that can hold a T.
+        void* allocate() {
+            ++live_;
+
+            if (free_) {
+                node* n = free_;
+                free_ = n->next;
+                return n->storage;
+            }
+
+            if (next_ == end_) grow_();
+            return (next_++)->storage;
+        }
+
+        /// Give a block back to the pool.
+        /** \param p The block to give back, previously returned by allocate()
+            \note The object that lived in this block must have been destroyed already.
+        **/
+        void deallocate(void* p) {
+            node* n = static_cast<node*>(p);
+            n->next = free_;
+            free_ = n;
+            --live_;
+        }
+
+        /// Return the memory of all the slabs to the system.
+        /** \note All the objects that lived in this pool must have been destroyed already. Any
+                  pointer previously returned by allocate() is invalidated.
+        **/
+        void release() {
+            slabs_.clear();
+            free_ = next_ = end_ = nullptr;
+            capacity_ = live_ = 0;
+        }
+
+        /// Return the number of blocks that are currently in use.
+        std::size_t size() const {
+            return live_;
+        }
+
+        /// Return the total number of blocks that have been allocated from the system.
+        std::size_t capacity() const {
+            return capacity_;
+        }
+
+        /// Return the size of a block, in bytes.
+        static constexpr std::size_t block_size() {
+            return sizeof(node);
+        }
+    };
+}
+
+#endif
@@ -6,16 +6,54 @@
 #include "sorted_vector.hpp"
 #include "range.hpp"
 #include "delegate.hpp"
+#include "slab_pool.hpp"
 #include <memory>
 #include <stdexcept>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <iterator>
+#include <cmath>
+#include <tbb/task_group.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 
 namespace space {
     /// Underlying type of a coordinate in the universe
     using pos_t = std::int32_t;
     /// Underlying type of a position in the universe
     using vec_t = vec2_t<pos_t>;
+    /// Underlying type of a box of cells in the universe (both corners are inclusive)
+    using box_t = axis_aligned_box2_t<pos_t>;
     /// List of all possible directions one can move in
     enum class direction { left = 0, up, right, down };
+    /// List of the available storage strategies for a universe, see universe::make()
+    enum class storage { tree, linear };
+    /// Maximum depth of a universe stored with storage::linear
+    /** The size of such a universe, 2^(D-1), must fit in a pos_t.
+    **/
+    constexpr std::size_t max_linear_depth = 31;
+
+    /// Memory used by a universe, see universe::memory_usage().
+    struct memory_stats {
+        /// Number of split cells at each level of the quad-tree, starting from the root.
+        /** This is always empty for storage::linear, which has no split cell.
+        **/
+        std::vector<std::size_t> split_cells;
+        /// Number of unit cells that are allocated, whether they contain an object or not.
+        std::size_t unit_cells = 0;
+        /// Number of unit cells that contain an object.
+        std::size_t occupied_cells = 0;
+        /// Number of bytes used by the cells and the bookkeeping of the universe.
+        std::size_t structure_bytes = 0;
+        /// Number of bytes allocated for the cells and the bookkeeping of the universe.
+        /** This includes structure_bytes, as well as the memory that is kept for reuse
+            (e.g., the memory of collapsed cells, see universe::collapse()).
+        **/
+        std::size_t reserved_bytes = 0;
+        /// Number of bytes held by the contained objects.
+        std::size_t object_bytes = 0;
+    };
 
     /// Base exception class that encompasses all the 'space' exceptions.
     namespace exception {
@@ -43,11 +81,32 @@ namespace space {
         struct invalid_position : public base {
             explicit invalid_position(const vec_t& pos);
         };
+
+        /// Exception raised when trying to create a universe with a depth that
+        /// is not supported by the chosen storage.
+        struct invalid_depth : public base {
+            explicit invalid_depth(std::size_t depth);
+        };
+
+        /// Exception raised when trying to create a cursor from a cell or a universe
+        /// that does not have the requested depth or storage.
+        struct invalid_cursor : public base {
+            explicit invalid_cursor(std::size_t depth);
+        };
+
+        /// Exception raised when trying to use a feature that is not supported by
+        /// the storage of a universe.
+        struct invalid_storage : public base {
+            explicit invalid_storage(const std::string& feature);
+        };
     }
 
     template<typename T>
     class cell;
 
+    template<typename T, std::size_t D>
+    class cursor;
+
     namespace impl {
         /// Underlying type of an internal coordinate.
         using pos_t = std::make_unsigned<space::pos_t>::type;
@@ -56,6 +115,205 @@ namespace space {
 
         template<typename T, std::size_t D>
         struct universe;
+
+        template<typename T>
+        struct linear_universe;
+
+        /// Interleave the bits of the two coordinates of the provided position to
+        /// build its Morton code (x bits are the even ones, y bits are the odd ones).
+        std::uint64_t morton_encode(const vec_t& pos);
+
+        /// Extract the position that corresponds to the provided Morton code.
+        vec_t morton_decode(std::uint64_t code);
+
+        /// Return the smallest Morton code greater or equal to 'code' that lies inside a box.
+        /** \param code The Morton code from which to start
+            \param kmin The Morton code of the top-left corner of the box (inclusive)
+            \param kmax The Morton code of the bottom-right corner of the box (inclusive)
+            \return The Morton code of a cell of the box, or std::uint64_t(-1) if all the
+                    cells of the box come before 'code'
+        **/
+        std::uint64_t morton_next_in_box(std::uint64_t code, std::uint64_t kmin,
+            std::uint64_t kmax);
+
+        /// Pointer that other threads can read while it is being modified.
+        /** The pointer is stored with release semantics and loaded with acquire semantics, so
+            that a thread that reads the pointer also sees the pointed object fully constructed.
+            It does not own the pointed object.
+        **/
+        template<typename P>
+        class published_ptr {
+        public :
+            published_ptr(P* p = nullptr) : ptr_(p) {}
+
+            published_ptr(published_ptr&& p) : ptr_(p.load()) {
+                p = nullptr;
+            }
+
+            published_ptr& operator = (published_ptr&& p) {
+                *this = p.load();
+                p = nullptr;
+                return *this;
+            }
+
+            published_ptr& operator = (P* p) {
+                ptr_.store(p, std::memory_order_release);
+                return *this;
+            }
+
+            P* load() const {
+                return ptr_.load(std::memory_order_acquire);
+            }
+
+            operator P* () const {
+                return load();
+            }
+
+            P* operator -> () const {
+                return load();
+            }
+
+            P& operator * () const {
+                return *load();
+            }
+
+        private :
+            std::atomic<P*> ptr_;
+        };
+
+        /// Keeps track of the threads that are reading a universe, see space::universe::read().
+        /** This implements epoch-based reclamation. The universe holds a global epoch, which
+            is advanced each time memory is retired. Each reader publishes the epoch at which it
+            started reading. Memory retired at a given epoch can be given back once all the
+            current readers have started after that epoch, since they can no longer reach it.
+        **/
+        class epoch_manager {
+        public :
+            /// Maximum number of threads that can read at the same time.
+            /** Additional readers wait until a slot is available.
+            **/
+            static constexpr std::size_t max_readers = 64;
+
+            epoch_manager() = default;
+            epoch_manager(const epoch_manager&) = delete;
+            epoch_manager& operator=(const epoch_manager&) = delete;
+
+            /// Register the calling thread as a reader.
+            /** \return The slot of this reader, to give back to leave()
+            **/
+            std::size_t enter();
+
+            /// Unregister a reader.
+            void leave(std::size_t slot);
+
+            /// Return the current epoch, to tag the memory that is retired.
+            std::uint64_t epoch() const;
+
+            /// Start a new epoch.
+            /** \note Call this function after retiring memory, and before reclaiming it.
+            **/
+            void advance();
+
+            /// Return the oldest epoch that is still in use.
+            /** \note Memory retired at an epoch strictly lower than this value can be reclaimed.
+            **/
+            std::uint64_t safe_epoch() const;
+
+        private :
+            struct alignas(64) slot {
+                /// The epoch at which the reader started, or zero if the slot is free.
+                std::atomic<std::uint64_t> epoch{0};
+            };
+
+            std::atomic<std::uint64_t> epoch_{1};
+            slot slots_[max_readers];
+        };
+
+        /// Record of the cells that have changed, see space::universe::changes_since().
+        /** The changes are grouped by epoch. Within an epoch, a cell is only listed once.
+        **/
+        class change_journal {
+        public :
+            /// Record a change in the cell with the provided Morton code.
+            void record(std::uint64_t key) {
+                entries_.push_back(entry{key, epoch_});
+            }
+
+            /// Return the current epoch.
+            std::uint64_t epoch() const {
+                return epoch_;
+            }
+
+            /// Close the current epoch and start a new one.
+            /** \return The new epoch
+            **/
+            std::uint64_t next_epoch() {
+                // Remove duplicates in the epoch that is closed
+                auto first = std::find_if(entries_.begin(), entries_.end(),
+                    [this](const entry& e) { return e.epoch == epoch_; });
+                std::sort(first, entries_.end(), [](const entry& e1, const entry& e2) {
+                    return e1.key < e2.key;
+                });
+                entries_.erase(std::unique(first, entries_.end(),
+                    [](const entry& e1, const entry& e2) {
+                        return e1.key == e2.key;
+                    }
+                ), entries_.end());
+
+                return ++epoch_;
+            }
+
+            /// Return the Morton codes of the cells that changed since the provided epoch.
+            /** \param epoch The first epoch to consider
+                \return The Morton codes, sorted and without duplicates
+            **/
+            std::vector<std::uint64_t> changes_since(std::uint64_t epoch) const {
+                auto first = std::lower_bound(entries_.begin(), entries_.end(), epoch,
+                    [](const entry& e, std::uint64_t ep) { return e.epoch < ep; });
+
+                std::vector<std::uint64_t> keys;
+                keys.reserve(entries_.end() - first);
+                for (auto iter = first; iter != entries_.end(); ++iter) {
+                    keys.push_back(iter->key);
+                }
+
+                std::sort(keys.begin(), keys.end());
+                keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+                return keys;
+            }
+
+            /// Forget about the changes that happened before the provided epoch.
+            void forget_before(std::uint64_t epoch) {
+                auto last = std::lower_bound(entries_.begin(), entries_.end(), epoch,
+                    [](const entry& e, std::uint64_t ep) { return e.epoch < ep; });
+                entries_.erase(entries_.begin(), last);
+            }
+
+            /// Forget about all the changes.
+            void clear() {
+                entries_.clear();
+            }
+
+            /// Return the number of recorded changes.
+            std::size_t size() const {
+                return entries_.size();
+            }
+
+            /// Add the memory used by this journal to the provided statistics.
+            void memory_usage(memory_stats& stats) const {
+                stats.structure_bytes += entries_.size()*sizeof(entry);
+                stats.reserved_bytes  += entries_.capacity()*sizeof(entry);
+            }
+
+        private :
+            struct entry {
+                std::uint64_t key;
+                std::uint64_t epoch;
+            };
+
+            std::vector<entry> entries_;
+            std::uint64_t epoch_ = 0;
+        };
     }
 
     /// The unit cell of the universe.
@@ -79,7 +337,9 @@ namespace space {
     template<typename T>
     class cell {
     public :
-        virtual ~cell() {}
+        virtual ~cell() {
+            delete obj_.load();
+        }
 
         /// Return a vector containing the absolute position of this cell.
         virtual vec_t get_coordinates() const = 0;
@@ -144,14 +404,16 @@ namespace space {
         T& fill(std::unique_ptr<T> t) {
             if (obj_) throw space::exception::cell_occupied();
 
-            obj_ = std::move(t);
+            obj_ = t.release();
             obj_notify_parent_cell_(this, has_notify_parent_cell());
+            notify_filled_();
 
             return *obj_;
         }
 
         /// Move the content of this cell into another one.
-        /** \param c The cell into which to move the content of this cell
+        /** \param c        The cell into which to move the content of this cell
+            \param nodelete See clear().
             \note An exception is thrown if the other cell already contains an object.
                   See cell_occupied_exception.
             \note If this cell doesn't contain anything, then this function does nothing.
@@ -161,36 +423,63 @@ namespace space {
                   parent. If you declare this function as private, do not forget to
                   befriend space::cell<T>.
         **/
-        void move_content_to(cell& c) {
+        void move_content_to(cell& c, bool nodelete = false) {
             if (!obj_) return;
             if (c.obj_) throw space::exception::cell_occupied();
 
-            c.obj_ = std::move(obj_);
-            obj_notify_parent_cell_(&c, has_notify_parent_cell());
+            c.obj_ = obj_.load();
+            obj_ = nullptr;
+            c.obj_notify_parent_cell_(&c, has_notify_parent_cell());
+            c.notify_filled_();
+            notify_empty_(nodelete);
         }
 
         /// Release the contained object so it can be moved elsewhere.
-        /** \note After this call, this cell becomes empty and the
+        /** \param nodelete See clear().
+            \note After this call, this cell becomes empty and the
                   object becomes owned by the caller.
             \note If T provides an accessible member function named 'notify_parent_cell'
                   that takes a reference to a space::cell<T> as its first and only
                   argument, then this function will call it to notify T that it no
                   longer has any parent. If you declare this function as private, do not
                   forget to befriend space::cell<T>.
+            \note Unlike with clear(), the object is handed over right away even if other
+                  threads are allowed to read the universe (see
+                  universe::set_concurrent_reads()), and they may still be reading it. While
+                  readers are active, the caller must therefore not destroy the released
+                  object. Placing it in another cell (as bulk_move() does) is safe, and an
+                  object that is no longer needed should be destroyed with clear() instead.
         **/
-        std::unique_ptr<T> release() {
+        std::unique_ptr<T> release(bool nodelete = false) {
+            if (!obj_) return nullptr;
+
             obj_notify_parent_cell_(nullptr, has_notify_parent_cell());
-            return std::move(obj_);
+            std::unique_ptr<T> obj(obj_.load());
+            obj_ = nullptr;
+            notify_empty_(nodelete);
+            return obj;
         }
 
         /// Destroy the contained object.
         /** \param nodelete If the parent of this cell does not contain any occupied
                             cell after this call, it will delete all its child cells
-                            to release memory. Set this value to 'false' to prevent it.
+                            to release memory. Set this value to 'true' to prevent it.
+            \note The child cells are not deleted immediately, so it is safe to keep using
+                  this cell after this call. They will be deleted by the next calls to
+                  universe::collapse(), see this function for more information.
+            \note If other threads are allowed to read the universe, the object is only
+                  destroyed once they can no longer access it (see
+                  universe::set_concurrent_reads()). It is notified that it no longer has
+                  any parent right away, as in release().
         **/
         void clear(bool nodelete = false) {
+            if (!obj_) return;
+
+            obj_notify_parent_cell_(nullptr, has_notify_parent_cell());
+            std::unique_ptr<T> obj(obj_.load());
             obj_ = nullptr;
-            notify_empty_();
+            dispose_(std::move(obj));
+            notify_empty_(nodelete);
         }
 
         /// Check if this cell contains an object.
@@ -198,6 +487,15 @@ namespace space {
             return obj_ == nullptr;
         }
 
+        /// Signal that the contained object has been modified.
+        /** \note The universe does not know when an object is modified, so this function must
+                  be called for the change to be listed by universe::changes_since().
+            \note If this cell doesn't contain anything, then this function does nothing.
+        **/
+        void touch() {
+            if (obj_) notify_touched_();
+        }
+
     protected :
         cell() = default;
         cell(const cell&) = delete;
@@ -206,7 +504,28 @@ namespace space {
         cell& operator=(cell&&) = default;
 
         /// Reimplemented by the actual cell type to notify its parent.
-        virtual void notify_empty_() {}
+        /** \param nodelete 'true' if the cell should not be scheduled for collapse
+            \note Only called if this cell did contain an object.
+        **/
+        virtual void notify_empty_(bool nodelete) {}
+
+        /// Reimplemented by the actual cell type to notify its parent.
+        virtual void notify_filled_() {}
+
+        /// Reimplemented by the actual cell type to notify its parent.
+        virtual void notify_touched_() {}
+
+        /// Reimplemented by the actual cell type to delay the destruction of an object.
+        /** \param obj The object that has been removed from this cell by clear()
+        **/
+        virtual void dispose_(std::unique_ptr<T> obj) {}
+
+        /// Return the content of this cell, or nullptr if it is empty.
+        /** \note The content is only read once, so this is safe to call from a reader thread.
+        **/
+        const T* try_content_() const {
+            return obj_.load();
+        }
 
     private :
         // Tools to check if T has a 'notify_parent_cell' member function
@@ -227,8 +546,8 @@ namespace space {
         void obj_notify_parent_cell_(cell* c, std::false_type) {}
 
     private :
-        /// The contained object, if any.
-        std::unique_ptr<T> obj_;
+        /// The contained object, if any (owned by this cell).
+        impl::published_ptr<T> obj_;
     };
 
     /// Contains all the space cells.
@@ -266,18 +585,57 @@ namespace space {
          * When N unit cells are created, the memory overhead that that is generated by their parent
            cells is, at best, 33% (compared to an ideal but impractical case where only the N unit
            cells are stored in memory).
+         * Split cells are not allocated individually on the heap, but are carved out of per-level
+           slabs owned by the universe (see ctl::slab_pool). The memory of collapsed cells is kept
+           for reuse, and only returned to the system when the universe is destroyed.
+         * The actual memory used by a universe can be measured with memory_usage().
 
         Any cell in this structure can be reached in O(D).
+
+        Alternatively, the universe can be stored as a "linear" quad-tree (see storage::linear).
+        In this case, only the occupied unit cells are stored, in a contiguous array sorted by
+        their Morton code (or Z-order, which is the order in which they would be visited in the
+        quad-tree). There is no intermediate cell, so the memory only scales with the number of
+        stored unit cells, and any cell can be reached in O(log(N)) with a binary search, where N
+        is the number of stored unit cells. Creating or removing a cell costs O(N) though, since
+        the array has to be kept sorted. This is a good choice for large universes where objects
+        do not move much, and which are mostly explored through their neighbors or by regions.
     **/
     template<typename T>
     class universe {
     public :
+        /// An object along with the position it should be placed at, see bulk_fill().
+        using positioned_object = std::pair<vec_t, std::unique_ptr<T>>;
+
         virtual ~universe() = default;
 
         /// Create a new universe of depth D.
+        /** \param s The storage strategy to use for this universe
+            \note With storage::linear, D must not be greater than max_linear_depth.
+        **/
         template<std::size_t D>
-        static std::unique_ptr<universe> make() {
-            return std::unique_ptr<universe>(new impl::universe<T,D>());
+        static std::unique_ptr<universe> make(storage s = storage::tree) {
+            switch (s) {
+            case storage::linear :
+                return std::unique_ptr<universe>(new impl::linear_universe<T>(D));
+            case storage::tree :
+            default :
+                return std::unique_ptr<universe>(new impl::universe<T,D>());
+            }
+        }
+
+        /// Create a new universe whose depth is only known at runtime.
+        /** \param depth The depth of the universe, between 1 and max_linear_depth
+            \note The universe is stored with storage::linear, so that the quad-tree is not
+                  instantiated for every possible depth, and its memory only scales with the
+                  number of stored cells. Finding a cell is O(log N), where N is the number of
+                  stored cells, but creating a single cell with reach() is O(N). Use
+                  bulk_fill() to place many objects at once, which is O(N + K log K) for K
+                  objects. Use make<D>() when the depth is known at compile time.
+            \note An exception is thrown if the depth is not supported. See invalid_depth.
+        **/
+        static std::unique_ptr<universe> make(std::size_t depth) {
+            return std::unique_ptr<universe>(new impl::linear_universe<T>(depth));
         }
 
         /// Return the number of cells that this universe contains in each dimension.
@@ -290,6 +648,13 @@ namespace space {
         **/
         virtual std::size_t depth() const = 0;
 
+        /// Check if the provided position lies inside this universe's boundaries.
+        bool contains(const vec_t& pos) const {
+            const std::int64_t s = size();
+            const std::int64_t h = s/2;
+            return pos.x >= -h && pos.x < s - h && pos.y >= -h && pos.y < s - h;
+        }
+
         /// Pick the cell that lies at the given position.
         /** \note Will create this cell if it doesn't exist. If you want to
                   navigate the space without affecting its structure, use
@@ -323,6 +688,120 @@ namespace space {
         **/
         virtual const cell<T>* try_reach(const vec_t& pos) const = 0;
 
+        /// Lazy range of the non-empty cells that lie inside a box, see query().
+        class cell_range {
+        public :
+            /// Forward iterator on the cells of a cell_range, in Z-order.
+            class iterator {
+            public :
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = const cell<T>;
+                using difference_type = std::ptrdiff_t;
+                using pointer = const cell<T>*;
+                using reference = const cell<T>&;
+
+                iterator() = default;
+
+                reference operator * () const {
+                    return *cell_;
+                }
+
+                pointer operator -> () const {
+                    return cell_;
+                }
+
+                iterator& operator ++ () {
+                    ++key_;
+                    cell_ = universe_->next_cell_in_(pmin_, pmax_, key_, hint_);
+                    return *this;
+                }
+
+                iterator operator ++ (int) {
+                    iterator i = *this;
+                    ++*this;
+                    return i;
+                }
+
+                bool operator == (const iterator& i) const {
+                    return cell_ == i.cell_;
+                }
+
+                bool operator != (const iterator& i) const {
+                    return cell_ != i.cell_;
+                }
+
+            private :
+                friend cell_range;
+
+                const universe* universe_ = nullptr;
+                impl::vec_t pmin_, pmax_;
+                std::uint64_t key_ = 0;
+                std::size_t hint_ = 0;
+                const cell<T>* cell_ = nullptr;
+            };
+
+            using const_iterator = iterator;
+
+            /// Return an iterator to the first cell of the range.
+            /** \note The cells are only searched for while iterating. Calling this function
+                      again will start the search from scratch.
+            **/
+            iterator begin() const {
+                iterator i;
+                if (empty_) return i;
+
+                i.universe_ = universe_;
+                i.pmin_ = pmin_;
+                i.pmax_ = pmax_;
+                i.cell_ = universe_->next_cell_in_(pmin_, pmax_, i.key_, i.hint_);
+                return i;
+            }
+
+            /// Return an iterator past the last cell of the range.
+            iterator end() const {
+                return iterator();
+            }
+
+        private :
+            friend universe;
+
+            cell_range(const universe& u, const box_t& box) : universe_(&u) {
+                // Clamp the box to the boundaries of the universe, and convert it into
+                // internal coordinates
+                const std::int64_t s = u.size();
+                const std::int64_t h = s/2;
+                const std::int64_t xmin = std::max(std::int64_t(box.p1.x) + h, std::int64_t(0));
+                const std::int64_t ymin = std::max(std::int64_t(box.p1.y) + h, std::int64_t(0));
+                const std::int64_t xmax = std::min(std::int64_t(box.p2.x) + h, s - 1);
+                const std::int64_t ymax = std::min(std::int64_t(box.p2.y) + h, s - 1);
+
+                empty_ = xmin > xmax || ymin > ymax;
+                if (!empty_) {
+                    pmin_ = impl::vec_t(xmin, ymin);
+                    pmax_ = impl::vec_t(xmax, ymax);
+                }
+            }
+
+            const universe* universe_;
+            impl::vec_t pmin_, pmax_;
+            bool empty_;
+        };
+
+        /// Lazily select all the non-empty cells that lie inside the provided box.
+        /** \param box The box in which to select the cells. Both corners are inclusive, and
+                       reference individual cells, much like the positions in reach() and
+                       try_reach(). The box can extend beyond the boundaries of the universe.
+            \return A range that can be iterated over to get the selected cells, in Z-order.
+            \note No cell is searched for until the returned range is iterated, and the search
+                  stops with the iteration. The only memory needed is that of the iterator.
+                  Subtrees that lie fully outside the box are skipped, and subtrees that lie
+                  fully inside are not tested against the box any further.
+            \note The structure of space shall not be modified while iterating.
+        **/
+        cell_range query(const box_t& box) const {
+            return cell_range(*this, box);
+        }
+
         /// Selects all the cells that lie inside the provided bounding box.
         /** \param box  The box in which to select the cells. The coordinates
                         must reference individual cells, much like the positions
@@ -332,9 +811,36 @@ namespace space {
                         of cells that will be selected and reserve enough memory
                         for them beforehand. This function will not take care
                         about it.
+            \note Prefer query(), which does not need to store the selected cells.
         **/
-        virtual void clip(const axis_aligned_box2d& box,
-            ctl::sorted_vector<const cell<T>&>& list) const = 0;
+        void clip(const axis_aligned_box2d& box,
+            ctl::sorted_vector<const cell<T>&>& list) const {
+
+            // Get the range of unit cells that overlap with the box
+            const double half_size = size()/2;
+            const double xmin = std::max(std::floor(box.p1.x), -half_size);
+            const double ymin = std::max(std::floor(box.p1.y), -half_size);
+            const double xmax = std::min(std::ceil(box.p2.x), size() - half_size) - 1.0;
+            const double ymax = std::min(std::ceil(box.p2.y), size() - half_size) - 1.0;
+            if (xmin > xmax || ymin > ymax) return;
+
+            cell_range cells = query(box_t(vec_t(xmin, ymin), vec_t(xmax, ymax)));
+
+            if (list.empty()) {
+                // Sort all the cells at once rather than inserting them one by one
+                std::vector<const cell<T>*> sorted;
+                for (const cell<T>& c : cells) {
+                    sorted.push_back(&c);
+                }
+
+                std::sort(sorted.begin(), sorted.end(), std::less<const cell<T>*>());
+                list = ctl::sorted_vector<const cell<T>&>(std::move(sorted));
+            } else {
+                for (const cell<T>& c : cells) {
+                    list.insert(c);
+                }
+            }
+        }
 
         /// Call the provided callback function on each non-empty cell in this universe.
         /** \param callback The callback function to call. Must return a boolean
@@ -358,12 +864,487 @@ namespace space {
             for_each_cell([&callback](const T& t) { callback(t); return true; });
         }
 
+        /// Default value of the 'split_level' argument of parallel_for_each_cell().
+        static const std::size_t default_split_level = 3;
+
+        /// Call the provided callback function on each non-empty cell in this universe, in parallel.
+        /** \param callback    The callback function to call. The callback shall not
+                               modify the structure of space, and will be called concurrently
+                               from multiple threads (but never twice for the same cell).
+            \param split_level The level of the quad-tree (0 being the root) at which the work
+                               is split into independent tasks. There will be at most
+                               4^split_level tasks, each one walking its sub-tree serially.
+            \note This function returns once all the cells have been visited.
+        **/
+        virtual void parallel_for_each_cell(const ctl::delegate<void(T&)>& callback,
+            std::size_t split_level = default_split_level) = 0;
+        /// @copydoc space::universe::parallel_for_each_cell
+        virtual void parallel_for_each_cell(const ctl::delegate<void(const T&)>& callback,
+            std::size_t split_level = default_split_level) const = 0;
+
+        /// Place a whole batch of objects in this universe at once.
+        /** \param objects The objects to place, along with their position, in any order
+            \return The number of objects that could not be placed
+            \note This is equivalent to calling reach(pos).fill(obj) for each object of the list,
+                  but much faster for large batches. The objects are sorted by Morton code, and
+                  the cells are then created in a single pass, each cell being visited (and
+                  split, if needed) only once.
+            \note This function does not throw if a position lies outside of this universe's
+                  boundaries, or if a cell is already occupied (either before the call, or by
+                  another object of the batch that comes first in the list). Such objects are
+                  simply not placed, and are left untouched in the list. All the other objects
+                  are moved out of the list, and their pointer is left to nullptr. The list
+                  itself is not reordered.
+        **/
+        virtual std::size_t bulk_fill(std::vector<positioned_object>& objects) = 0;
+
+        /// A request to move the object of a cell into another cell, see bulk_move().
+        using object_move = std::pair<vec_t, vec_t>;
+
+        /// Move a whole batch of objects at once.
+        /** \param moves The moves to apply, as pairs of (source, destination) positions, in
+                         any order
+            \return The number of moves that could not be applied
+            \note All the moves are applied simultaneously: all the objects are first released
+                  from their cell, and are then placed in their destination cell with
+                  bulk_fill(). Objects can therefore move into a cell that is being left by
+                  another object of the batch, and two objects can swap their position.
+            \note This function does not throw. A move is rejected if:
+                   - its source or destination lies outside of this universe's boundaries,
+                   - its source is empty, or is the source of another move that comes first in
+                     the list,
+                   - its destination is the destination of another move that comes first in the
+                     list,
+                   - its destination is occupied by an object that does not move away (either
+                     because it is not part of the batch, or because its own move was rejected).
+                  The result is therefore deterministic, and does not depend on the storage nor
+                  on the order in which the cells are visited. The objects of the rejected moves
+                  stay in place, and on return the list only contains these moves, in their
+                  original order. Moves whose source and destination are equal are ignored:
+                  they are neither applied nor rejected.
+        **/
+        std::size_t bulk_move(std::vector<object_move>& moves) {
+            const std::size_t n = moves.size();
+            const pos_t half_size = size()/2;
+            auto key_of = [half_size](const vec_t& p) {
+                return impl::morton_encode(impl::vec_t(p + vec_t(half_size, half_size)));
+            };
+
+            std::vector<std::uint64_t> from(n, 0), to(n, 0);
+            std::vector<cell<T>*> sources(n, nullptr);
+            std::vector<bool> accepted(n, false);
+            std::vector<bool> rejected(n, false);
+
+            // Check the sources; only the first move from a given cell is considered
+            std::vector<std::size_t> by_from;
+            for (std::size_t i = 0; i < n; ++i) {
+                if (moves[i].first == moves[i].second) continue;
+                if (!contains(moves[i].first)) {
+                    rejected[i] = true;
+                    continue;
+                }
+
+                from[i] = key_of(moves[i].first);
+                by_from.push_back(i);
+            }
+
+            std::stable_sort(by_from.begin(), by_from.end(), [&](std::size_t i, std::size_t j) {
+                return from[i] < from[j];
+            });
+
+            // The cells are sorted by Morton code, so they can all be found in a single pass
+            std::vector<std::uint64_t> keys;
+            std::vector<const cell<T>*> cells;
+            keys.reserve(by_from.size());
+            for (std::size_t i : by_from) keys.push_back(from[i]);
+            try_reach_sorted_(keys, cells);
+
+            for (std::size_t k = 0; k < by_from.size(); ++k) {
+                std::size_t i = by_from[k];
+                const object_move& m = moves[i];
+
+                const cell<T>* c = nullptr;
+                if (k == 0 || from[by_from[k-1]] != from[i]) c = cells[k];
+
+                if (!c || c->empty() || !contains(m.second)) {
+                    rejected[i] = true;
+                } else {
+                    to[i] = key_of(m.second);
+                    sources[i] = const_cast<cell<T>*>(c);
+                    accepted[i] = true;
+                }
+            }
+
+            // Check the destinations; only the first move to a given cell is considered
+            std::vector<std::size_t> by_to;
+            for (std::size_t i = 0; i < n; ++i) {
+                if (accepted[i]) by_to.push_back(i);
+            }
+
+            std::stable_sort(by_to.begin(), by_to.end(), [&](std::size_t i, std::size_t j) {
+                return to[i] < to[j];
+            });
+
+            // Rejected moves leave an object in their source cell, which in turn blocks the
+            // move that was heading there (if any). Follow these chains until nothing changes.
+            std::vector<std::size_t> blocked;
+            for (std::size_t k = 1; k < by_to.size(); ++k) {
+                if (to[by_to[k-1]] == to[by_to[k]]) {
+                    accepted[by_to[k]] = false;
+                    blocked.push_back(by_to[k]);
+                }
+            }
+
+            auto moving_from = [&](std::uint64_t key) {
+                auto iter = std::lower_bound(by_from.begin(), by_from.end(), key,
+                    [&](std::size_t i, std::uint64_t k) { return from[i] < k; });
+                return iter != by_from.end() && from[*iter] == key && accepted[*iter];
+            };
+
+            auto moving_to = [&](std::uint64_t key) -> std::size_t {
+                auto iter = std::lower_bound(by_to.begin(), by_to.end(), key,
+                    [&](std::size_t i, std::uint64_t k) { return to[i] < k; });
+                for (; iter != by_to.end() && to[*iter] == key; ++iter) {
+                    if (accepted[*iter]) return *iter;
+                }
+                return n;
+            };
+
+            keys.clear();
+            for (std::size_t i : by_to) keys.push_back(to[i]);
+            try_reach_sorted_(keys, cells);
+
+            for (std::size_t k = 0; k < by_to.size(); ++k) {
+                std::size_t i = by_to[k];
+                if (!accepted[i]) continue;
+                const cell<T>* c = cells[k];
+                if (c && !c->empty() && !moving_from(to[i])) {
+                    accepted[i] = false;
+                    blocked.push_back(i);
+                }
+            }
+
+            while (!blocked.empty()) {
+                std::size_t i = blocked.back();
+                blocked.pop_back();
+                rejected[i] = true;
+
+                std::size_t j = moving_to(from[i]);
+                if (j != n) {
+                    accepted[j] = false;
+                    blocked.push_back(j);
+                }
+            }
+
+            // Apply the moves
+            std::vector<positioned_object> objects;
+            std::vector<std::size_t> applied;
+            for (std::size_t i = 0; i < n; ++i) {
+                if (!accepted[i]) continue;
+                objects.emplace_back(moves[i].second, sources[i]->release());
+                applied.push_back(i);
+            }
+
+            if (bulk_fill(objects) != 0) {
+                // The checks above should leave every destination free. Should bulk_fill()
+                // still leave an object behind, it goes back to its source rather than being
+                // destroyed: the source can only have been taken by an object that was placed,
+                // which means that it was free.
+                for (std::size_t j = 0; j < objects.size(); ++j) {
+                    if (!objects[j].second) continue;
+                    std::size_t i = applied[j];
+                    if (sources[i]->empty()) {
+                        sources[i]->fill(std::move(objects[j].second));
+                        rejected[i] = true;
+                    }
+                }
+            }
+
+            // Only keep the rejected moves in the list
+            std::size_t nfail = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                if (rejected[i]) moves[nfail++] = moves[i];
+            }
+
+            moves.resize(nfail);
+            return nfail;
+        }
+
+        /// Default value for set_collapse_delay().
+        static const std::size_t default_collapse_delay = 1;
+
+        /// Free the memory of the regions of space that no longer contain any object.
+        /** When a cell is emptied (see cell::clear(), cell::release() and
+            cell::move_content_to()), it is scheduled for collapse. This function goes through
+            the cells that have been scheduled, and if they are still empty, deletes them along
+            with all their parent cells that no longer contain any occupied cell. The memory is
+            given back to the universe's memory pools, to be reused by the next cells that will
+            be created.
+            To avoid repeatedly deleting and re-creating the same cells when objects are moving
+            around, a cell is only collapsed if it was scheduled at least collapse_delay() calls
+            to this function ago (counting the current call), see set_collapse_delay().
+            \note This function will invalidate all pointers and references to the deleted
+                  cells, as well as any cursor that points to them (see cursor::refresh()). It
+                  is therefore best to call it at regular intervals, at a moment when no such
+                  pointer or reference is kept.
+            \return The number of bytes that have been given back to the memory pools
+        **/
+        virtual std::size_t collapse() = 0;
+
+        /// Set the number of calls to collapse() a cell has to wait before being collapsed.
+        /** \param delay The new delay. If zero, the cells that have been emptied are
+                         collapsed on the next call to collapse().
+        **/
+        virtual void set_collapse_delay(std::size_t delay) = 0;
+
+        /// Return the number of calls to collapse() a cell has to wait before being collapsed.
+        virtual std::size_t collapse_delay() const = 0;
+
+        /// Return the number of nodes that are currently allocated to store space.
+        /** For storage::tree, this is the number of split cells, and for storage::linear
+            this is the number of stored unit cells (occupied or not).
+        **/
+        virtual std::size_t node_count() const = 0;
+
+        /// Return the total number of bytes that collapse() has reclaimed so far.
+        virtual std::size_t reclaimed_bytes() const = 0;
+
+        /// Return the number of objects in this universe.
+        /** \note The count is kept up to date as cells are filled or emptied, so this is O(1).
+        **/
+        virtual std::size_t object_count() const = 0;
+
+        /// Return the number of objects in a region of space.
+        /** \param pos   A position inside the region
+            \param level The level of detail of the region: 0 is the whole universe, 1 is one of
+                         its four quadrants, etc., up to depth()-1 which is a single unit cell.
+                         Larger values are treated as depth()-1.
+            \return The number of objects in the region, or 0 if 'pos' is outside of this
+                    universe's boundaries
+            \note For storage::tree, each cell keeps track of the number of objects it contains,
+                  so this is O(level). For storage::linear, this is O(log(N) + M), where N is the
+                  number of stored cells and M the number of stored cells in the region.
+        **/
+        virtual std::size_t object_count(const vec_t& pos, std::size_t level) const = 0;
+
+        /// Compute the number of objects in each region of space at a given level of detail.
+        /** \param level The level of detail of the regions, see object_count()
+            \param map   The container in which to store the number of objects. It will be
+                         resized to hold 2^level x 2^level regions, the region at (x,y) (starting
+                         from the top-left corner of the universe) being at index x + y*2^level.
+            \note Regions that contain no object are not explored.
+        **/
+        virtual void density_map(std::size_t level, std::vector<std::size_t>& map) const = 0;
+
+        /// Measure the memory used by this universe.
+        /** \return The memory statistics. The size of each object is assumed to be sizeof(T),
+                    so this is O(D) for storage::tree, and O(1) for storage::linear.
+            \note Use the other overload if the objects own additional memory, or if T is the
+                  base class of the objects.
+        **/
+        memory_stats memory_usage() const {
+            memory_stats stats;
+            memory_usage_(stats);
+            journal_.memory_usage(stats);
+            stats.object_bytes = stats.occupied_cells*sizeof(T);
+            return stats;
+        }
+
+        /// Measure the memory used by this universe.
+        /** \param object_size A function returning the number of bytes held by an object
+            \return The memory statistics
+            \note This calls object_size() on each object, so this is O(N) where N is the
+                  number of objects.
+        **/
+        memory_stats memory_usage(const ctl::delegate<std::size_t(const T&)>& object_size) const {
+            memory_stats stats;
+            memory_usage_(stats);
+            journal_.memory_usage(stats);
+            for_each_cell([&](const T& obj) {
+                stats.object_bytes += object_size(obj);
+            });
+            return stats;
+        }
+
+        /// Start or stop recording the changes made to the content of this universe.
+        /** \param enabled 'true' to start recording, 'false' to stop and forget all the
+                           changes that have been recorded so far
+            \note The journal is disabled by default. When enabled, the universe keeps track of
+                  all the cells that are filled or emptied (see cell::fill(), cell::clear(),
+                  cell::release() and cell::move_content_to()), as well as the cells whose
+                  content has been modified (see cell::touch()). This allows processing only
+                  what changed since a given epoch (see changes_since()), rather than the whole
+                  universe.
+        **/
+        void set_journal_enabled(bool enabled) {
+            journal_enabled_ = enabled;
+            if (!enabled) journal_.clear();
+        }
+
+        /// Check if the changes made to this universe are recorded, see set_journal_enabled().
+        bool journal_enabled() const {
+            return journal_enabled_;
+        }
+
+        /// Return the current epoch of the journal.
+        /** \note All the changes are recorded in the current epoch.
+        **/
+        std::uint64_t epoch() const {
+            return journal_.epoch();
+        }
+
+        /// Start a new epoch in the journal.
+        /** \return The new epoch. Calling changes_since() with this value will only list the
+                    changes made after this call.
+        **/
+        std::uint64_t next_epoch() {
+            return journal_.next_epoch();
+        }
+
+        /// List the cells that changed since the provided epoch.
+        /** \param epoch The first epoch to consider (inclusive)
+            \param cells The container in which to store the positions of the cells that
+                         changed, in Z-order and without duplicates. The cells may have been
+                         emptied since then, or even collapsed.
+            \note The changes made before forget_changes_before() was called are not listed.
+        **/
+        void changes_since(std::uint64_t epoch, std::vector<vec_t>& cells) const {
+            const space::pos_t half_size = size()/2;
+            for (std::uint64_t key : journal_.changes_since(epoch)) {
+                cells.push_back(vec_t(impl::morton_decode(key)) - vec_t(half_size, half_size));
+            }
+        }
+
+        /// Forget about the changes that happened before the provided epoch.
+        /** \note Use this function once all the changes up to a given epoch have been
+                  processed, to release the memory used by the journal.
+        **/
+        void forget_changes_before(std::uint64_t epoch) {
+            journal_.forget_before(epoch);
+        }
+
+        /// Allow other threads to read this universe while it is being modified.
+        /** \param enabled 'true' to allow concurrent reads, 'false' to forbid them
+            \note When enabled, one thread (the "writer") can keep modifying the universe, while
+                  any number of other threads read it (see read()), without any lock. To make
+                  this possible, the memory that is removed from the universe (the objects
+                  destroyed by cell::clear(), and the cells deleted by collapse()) is not
+                  released immediately, but only by the next calls to collapse() once no reader
+                  can still access it.
+            \note Objects taken out with cell::release() are owned by the caller, and are not
+                  protected: they must not be destroyed while a reader may still access them.
+            \note Only storage::tree supports concurrent reads. An exception is thrown when
+                  trying to enable them on another storage. See invalid_storage.
+            \note Concurrent reads must not be disabled while a thread is still reading.
+        **/
+        virtual void set_concurrent_reads(bool enabled) = 0;
+
+        /// Check if other threads are allowed to read this universe, see set_concurrent_reads().
+        virtual bool concurrent_reads() const = 0;
+
+        /// Registers a thread as a reader of a universe, see read().
+        class read_guard {
+        public :
+            read_guard(read_guard&& g) : epochs_(g.epochs_), slot_(g.slot_) {
+                g.epochs_ = nullptr;
+            }
+
+            read_guard(const read_guard&) = delete;
+            read_guard& operator=(const read_guard&) = delete;
+            read_guard& operator=(read_guard&&) = delete;
+
+            ~read_guard() {
+                if (epochs_) epochs_->leave(slot_);
+            }
+
+        private :
+            friend universe;
+
+            explicit read_guard(impl::epoch_manager& epochs) :
+                epochs_(&epochs), slot_(epochs.enter()) {}
+
+            impl::epoch_manager* epochs_;
+            std::size_t slot_;
+        };
+
+        /// Start reading this universe from a thread that does not modify it.
+        /** \return A guard that must be kept alive as long as the calling thread is reading
+                    the universe. Any pointer or reference to a cell or an object obtained while
+                    the guard is alive must not be used after the guard is destroyed.
+            \note This only matters if concurrent reads are enabled, see set_concurrent_reads().
+                  While the guard is alive, the calling thread can use the const member
+                  functions of this universe (try_reach(), query(), clip(), for_each_cell(),
+                  object_count(), ...), as well as the const member functions of the cells,
+                  while another thread modifies the universe. The reader may or may not see the
+                  modifications that are made in the meantime. Accessing the content of the
+                  objects concurrently is the responsibility of T.
+            \note A cell that is collapsed while a thread is reading it remains readable, but
+                  it is no longer part of the universe: its neighbors and coordinates can no
+                  longer be computed (see cell::try_reach() and cell::get_coordinates()). Since
+                  only empty cells are collapsed, a reader should not query a cell after it has
+                  found it empty.
+            \note Readers are never blocked by the writer, and the writer is never blocked by
+                  the readers. At most impl::epoch_manager::max_readers threads can read at the
+                  same time, other threads wait until a reader releases its guard.
+        **/
+        read_guard read() const {
+            return read_guard(epochs_);
+        }
+
     protected :
+        /// Find the first non-empty cell inside a box, starting from a given Morton code.
+        /** \param pmin The top-left corner of the box, in internal coordinates (inclusive)
+            \param pmax The bottom-right corner of the box, in internal coordinates (inclusive)
+            \param key  The Morton code from which to start the search. Will be set to the
+                        Morton code of the found cell.
+            \param hint Where the previous search of the same range stopped, in a form that
+                        only the storage understands. Starts at zero, and shall be passed back
+                        untouched to the next call.
+            \return The first non-empty cell inside the box whose Morton code is greater or equal
+                    to 'key', or nullptr if there is none
+        **/
+        virtual const cell<T>* next_cell_in_(const impl::vec_t& pmin, const impl::vec_t& pmax,
+            std::uint64_t& key, std::size_t& hint) const = 0;
+
+        /// Find the cells with the provided Morton codes, see bulk_move().
+        /** \param keys  The Morton codes of the cells to find, sorted in increasing order
+            \param cells Will contain the found cells, in the same order as 'keys', or nullptr for
+                         the cells that do not exist
+        **/
+        virtual void try_reach_sorted_(const std::vector<std::uint64_t>& keys,
+            std::vector<const cell<T>*>& cells) const = 0;
+
+        /// Fill the statistics about the structure of this universe, see memory_usage().
+        /** \note The memory used by the base class (i.e., the journal) and by the objects is
+                  added by memory_usage().
+        **/
+        virtual void memory_usage_(memory_stats& stats) const = 0;
+
+        /// Record a change in the cell with the provided Morton code, see changes_since().
+        void record_change_(std::uint64_t key) {
+            if (journal_enabled_) journal_.record(key);
+        }
+
         universe() = default;
         universe(const universe&) = delete;
         universe& operator=(const universe&) = delete;
         universe(universe&&) = default;
         universe& operator=(universe&&) = default;
+
+        /// Return the epochs of the readers of this universe, see read().
+        impl::epoch_manager& epoch_manager_() const {
+            return epochs_;
+        }
+
+    private :
+        /// See set_journal_enabled().
+        bool journal_enabled_ = false;
+
+        /// The threads that are currently reading this universe, see read().
+        mutable impl::epoch_manager epochs_;
+
+        /// The changes recorded so far, see changes_since().
+        impl::change_journal journal_;
     };
 
     // Implementation classes, should not be used directly.
@@ -379,18 +1360,43 @@ namespace space {
         template<typename T, std::size_t N, std::size_t D>
         struct any_cell;
 
-        /// Contains four other cells.
-        /** The only purpose of this class is to contain four cells,
-            nothing more. They are allocated contiguously in memory.
+        /// Nothing to store for the split cells that do not contain unit cells.
+        template<typename T, std::size_t D, bool Last>
+        struct split_cell_base {
+            explicit split_cell_base(universe<T,D>&) {}
+        };
+
+        /// Gives the unit cells a direct access to their universe.
+        /** This saves walking up the quad-tree each time a unit cell needs the universe,
+            for a pointer per group of four unit cells.
         **/
-        template<typename T, std::size_t N, std::size_t D>
-        struct split_cell {
+        template<typename T, std::size_t D>
+        struct split_cell_base<T,D,true> {
+            explicit split_cell_base(universe<T,D>& u) : universe_(u) {}
+
+            /// The universe the children of this cell belong to.
+            universe<T,D>& universe_;
+        };
+
+        /// Contains four other cells.
+        /** The only purpose of this class is to contain four cells,
+            nothing more. They are allocated contiguously in memory.
+        **/
+        template<typename T, std::size_t N, std::size_t D>
+        struct split_cell : split_cell_base<T,D,N+1 == D> {
             any_cell<T,N+1,D> children[4];
 
+            /// The number of occupied unit cells below this cell.
+            /** \note Only modified by the thread that modifies the universe, but can be read
+                      by other threads (see space::universe::read()).
+            **/
+            std::atomic<std::size_t> count{0};
+
         private :
             friend any_cell<T,N,D>;
 
-            explicit split_cell(any_cell<T,N,D>& self) : children{
+            split_cell(universe<T,D>& u, any_cell<T,N,D>& self) :
+                split_cell_base<T,D,N+1 == D>(u), children{
                 any_cell<T,N+1,D>(self), any_cell<T,N+1,D>(self),
                 any_cell<T,N+1,D>(self), any_cell<T,N+1,D>(self)
             } {}
@@ -401,12 +1407,158 @@ namespace space {
             split_cell& operator=(split_cell&&) = default;
         };
 
+        /// An object of a batch sorted by Morton code, see space::universe::bulk_fill().
+        template<typename T>
+        struct bulk_item {
+            std::uint64_t key;
+            typename space::universe<T>::positioned_object* obj;
+        };
+
+        /// Sort a batch of objects by Morton code, discarding the invalid positions.
+        /** \param objects The batch of objects
+            \param u       The universe in which the objects will be placed
+            \return The sorted batch. Objects with the same position are sorted in the order in
+                    which they appear in the original list.
+        **/
+        template<typename T>
+        std::vector<bulk_item<T>> sort_batch(
+            std::vector<typename space::universe<T>::positioned_object>& objects,
+            const space::universe<T>& u) {
+
+            const space::pos_t half_size = u.size()/2;
+
+            std::vector<bulk_item<T>> items;
+            items.reserve(objects.size());
+            for (auto& o : objects) {
+                if (!o.second || !u.contains(o.first)) continue;
+                vec_t pos(o.first + space::vec_t(half_size, half_size));
+                items.push_back(bulk_item<T>{morton_encode(pos), &o});
+            }
+
+            std::stable_sort(items.begin(), items.end(),
+                [](const bulk_item<T>& i1, const bulk_item<T>& i2) {
+                    return i1.key < i2.key;
+                }
+            );
+
+            return items;
+        }
+
+        /// List of the unit cells that have been emptied, see space::universe::collapse().
+        class collapse_queue {
+        public :
+            /// Schedule the cell with the provided Morton code for collapse.
+            void push(std::uint64_t key) {
+                pending_.push_back(entry{key, generation_});
+
+                // A cell that is emptied over and over is pushed each time. Drop the older
+                // entries whenever the queue has doubled, so that it stays proportional to the
+                // number of distinct cells even if pop() is not called for a long time.
+                if (pending_.size() >= 2*compacted_size_) {
+                    sort_pending_();
+                    remove_duplicates_();
+                }
+            }
+
+            /// Return the cells that have waited long enough, and forget about them.
+            /** \param delay The number of calls to this function a cell has to wait
+                \return The Morton codes of the cells to collapse, sorted and without duplicates
+                \note If a cell has been scheduled several times, only the last time counts.
+            **/
+            std::vector<std::uint64_t> pop(std::size_t delay) {
+                ++generation_;
+                sort_pending_();
+
+                remove_duplicates_();
+
+                std::vector<std::uint64_t> keys;
+                std::size_t n = 0;
+                for (std::size_t i = 0; i < pending_.size(); ++i) {
+                    if (pending_[i].generation + delay < generation_) {
+                        keys.push_back(pending_[i].key);
+                    } else {
+                        pending_[n++] = pending_[i];
+                    }
+                }
+
+                pending_.resize(n);
+                compacted_size_ = std::max(n, min_compacted_size);
+                return keys;
+            }
+
+            /// Return the number of cells that are waiting to be collapsed.
+            std::size_t size() const {
+                return pending_.size();
+            }
+
+            /// Add the memory used by this queue to the provided statistics.
+            void memory_usage(memory_stats& stats) const {
+                stats.structure_bytes += pending_.size()*sizeof(entry);
+                stats.reserved_bytes  += pending_.capacity()*sizeof(entry);
+            }
+
+        private :
+            struct entry {
+                std::uint64_t key;
+                std::size_t generation;
+            };
+
+            /// Size of the queue below which it is never compacted by push().
+            static constexpr std::size_t min_compacted_size = 1024;
+
+            std::vector<entry> pending_;
+            std::size_t generation_ = 0;
+            /// Size of the queue after it was last compacted.
+            std::size_t compacted_size_ = min_compacted_size;
+
+            /// Only keep the last entry of each cell.
+            /** \note The entries must be sorted, see sort_pending_().
+            **/
+            void remove_duplicates_() {
+                std::size_t n = 0;
+                for (std::size_t i = 0; i < pending_.size(); ++i) {
+                    if (i+1 < pending_.size() && pending_[i+1].key == pending_[i].key) continue;
+                    pending_[n++] = pending_[i];
+                }
+
+                pending_.resize(n);
+                compacted_size_ = std::max(n, min_compacted_size);
+            }
+
+            /// Sort the pending entries by Morton code.
+            /** This is a radix sort, which is stable: the entries of a given cell stay in the
+                order in which they were pushed, i.e. sorted by generation.
+            **/
+            void sort_pending_() {
+                std::uint64_t bits = 0;
+                for (auto& e : pending_) bits |= e.key;
+
+                std::vector<entry> sorted(pending_.size());
+                for (std::size_t shift = 0; shift < 64 && (bits >> shift) != 0; shift += 8) {
+                    std::size_t offsets[257] = {};
+                    for (auto& e : pending_) ++offsets[((e.key >> shift) & 0xff) + 1];
+                    for (std::size_t i = 1; i < 257; ++i) offsets[i] += offsets[i-1];
+                    for (auto& e : pending_) sorted[offsets[(e.key >> shift) & 0xff]++] = e;
+                    std::swap(pending_, sorted);
+                }
+            }
+        };
+
         /// Return true if the requested cell lies within this split cell,
         /// false if it lies in a neighboring cell.
         /// Set 'next_id' to the id of the requested cell in its parent's
         /// child list.
         bool get_cell_id(std::size_t id, direction dir, std::size_t& next_id);
 
+        /// Update the occupancy count of a split cell.
+        /** \note The count is only modified by the thread that modifies the universe, so it
+                  does not need an atomic read-modify-write operation.
+        **/
+        inline void add_count_(std::atomic<std::size_t>& count, bool filled) {
+            std::size_t c = count.load(std::memory_order_relaxed);
+            count.store(filled ? c + 1 : c - 1, std::memory_order_relaxed);
+        }
+
         /// A cell of the space quad-tree, can either be empty or split.
         template<typename T, std::size_t N, std::size_t D>
         struct any_cell {
@@ -418,14 +1570,28 @@ namespace space {
             **/
             bool empty() const { return split == nullptr; }
 
+            /// Return the number of occupied unit cells below this cell.
+            std::size_t count() const {
+                split_cell<T,N,D>* s = split;
+                return s ? s->count.load(std::memory_order_relaxed) : 0;
+            }
+
             /// Split this cell into several subcells to refine the sampling of space.
-            void make_split() { split.reset(new split_cell<T,N,D>(*this)); }
+            /** \param u The universe this cell belongs to, which provides the memory
+            **/
+            void make_split(universe<T,D>& u) {
+                split = new (u.template split_pool<N>().allocate()) split_cell<T,N,D>(u, *this);
+            }
 
             /// The parent of this cell.
             any_cell<T,N-1,D>& parent;
 
             /// The split sub-cells, if any.
-            std::unique_ptr<split_cell<T,N,D>> split;
+            /** \note Other threads may be reading this pointer (see space::universe::read()),
+                      so it should only be loaded once by functions that can be called by
+                      these threads.
+            **/
+            published_ptr<split_cell<T,N,D>> split;
 
         private :
             explicit any_cell(any_cell<T,N-1,D>& parent) : parent(parent) {}
@@ -434,15 +1600,42 @@ namespace space {
             any_cell(any_cell&&) = default;
             any_cell& operator=(any_cell&&) = default;
 
-            /// Called when a child cell is emptied, in order to free
-            /// some memory when the space in unoccupied.
-            void on_cell_empty_() {
-                for (auto& c : split->children) {
-                    if (!c.empty()) return;
-                }
+            /// Return the universe this cell belongs to.
+            /** \note This walks up the whole quad-tree, and should only be used when
+                      the structure of space is about to change.
+            **/
+            universe<T,D>& get_universe_() {
+                return parent.get_universe_();
+            }
+
+            /// Called when a unit cell below this one is filled or emptied.
+            /** \param c      The child cell that contains the unit cell
+                \param filled 'true' if the cell was filled, 'false' if it was emptied
+                \param key    Variable holding the Morton code of the unit cell
+                \note The count is updated all the way up to the root. The Morton code is
+                      built along the way, so that the quad-tree is only walked up once.
+            **/
+            void notify_count_(const any_cell<T,N+1,D>& c, bool filled, std::uint64_t& key) {
+                split_cell<T,N,D>* s = split;
+                add_count_(s->count, filled);
+                key |= sub_key_(c, s);
+                parent.notify_count_(*this, filled, key);
+            }
+
+            /// Called by the child cells to build their Morton code.
+            /** \param c   The child cell that required the computation
+                \param key Variable holding the Morton code
+                \note Each cell adds to the code the two bits of its sub-cell.
+            **/
+            void get_key_(const any_cell<T,N+1,D>& c, std::uint64_t& key) const {
+                key |= sub_key_(c, split.load());
+                parent.get_key_(*this, key);
+            }
 
-                split.reset();
-                parent.on_cell_empty_();
+            /// Return the contribution of one of the sub-cells to the Morton code.
+            static std::uint64_t sub_key_(const any_cell<T,N+1,D>& c, const split_cell<T,N,D>* s) {
+                static const std::size_t shift = 2*(D-N-1);
+                return std::uint64_t(&c - &s->children[0]) << shift;
             }
 
             /// Called by the child cells to build their absolute position.
@@ -454,7 +1647,7 @@ namespace space {
             void get_coordinates_(const any_cell<T,N+1,D>& c, vec_t& pos) const {
                 static const std::size_t half_size = 1 << (D-N-1);
 
-                std::size_t i = &c - &split->children[0];
+                std::size_t i = &c - &split.load()->children[0];
                 switch (i) {
                 case sub_cell::TL :                                         break;
                 case sub_cell::TR : pos.x += half_size;                     break;
@@ -475,7 +1668,7 @@ namespace space {
             any_cell<T,N+1,D>* get_neighbor_cell_(direction dir, std::size_t id) {
                 any_cell<T,N,D>* next = parent.reach_(*this, dir);
                 if (next) {
-                    if (!next->split) next->make_split();
+                    if (!next->split) next->make_split(get_universe_());
                     return &next->split->children[id];
                 } else {
                     return nullptr;
@@ -492,8 +1685,9 @@ namespace space {
             const any_cell<T,N+1,D>* try_get_neighbor_cell_(direction dir, std::size_t id) const {
                 const any_cell<T,N,D>* next = parent.try_reach_(*this, dir);
                 if (next) {
-                    if (!next->split) return nullptr;
-                    else return &next->split->children[id];
+                    const split_cell<T,N,D>* s = next->split;
+                    if (!s) return nullptr;
+                    else return &s->children[id];
                 } else {
                     return nullptr;
                 }
@@ -521,9 +1715,10 @@ namespace space {
                 \note Will not create this neighbor if it doesn't exists.
             **/
             const any_cell<T,N+1,D>* try_reach_(const any_cell<T,N+1,D>& c, direction dir) const {
+                const split_cell<T,N,D>* s = split;
                 std::size_t next_id;
-                if (get_cell_id(&c - &split->children[0], dir, next_id)) {
-                    return &split->children[next_id];
+                if (get_cell_id(&c - &s->children[0], dir, next_id)) {
+                    return &s->children[next_id];
                 } else {
                     return try_get_neighbor_cell_(dir, next_id);
                 }
@@ -553,6 +1748,11 @@ namespace space {
                 return parent.try_reach_(*this, dir);
             }
 
+            /// Return the content of this cell, or nullptr if it is empty.
+            const T* try_content() const {
+                return cell<T>::try_content_();
+            }
+
             /// The parent of this cell.
             any_cell<T,D-1,D>& parent;
 
@@ -564,11 +1764,61 @@ namespace space {
             any_cell& operator=(any_cell&&) = default;
 
             /// Called when the content of this cell is destroyed.
-            /** Will free some memory if possible, see any_cell::on_cell_empty_.
+            /** Will schedule this cell for collapse, see space::universe::collapse().
+            **/
+            void notify_empty_(bool nodelete) override {
+                cell<T>::notify_empty_(nodelete);
+
+                std::uint64_t key = 0;
+                parent.notify_count_(*this, false, key);
+
+                universe<T,D>& u = get_universe_();
+                if (nodelete && !u.journal_enabled()) return;
+
+                u.record_change(key);
+                if (!nodelete) u.schedule_collapse(key);
+            }
+
+            /// Called when an object is put in this cell.
+            /** Will update the occupancy count of all the parent cells.
+            **/
+            void notify_filled_() override {
+                cell<T>::notify_filled_();
+
+                std::uint64_t key = 0;
+                parent.notify_count_(*this, true, key);
+
+                universe<T,D>& u = get_universe_();
+                if (u.journal_enabled()) u.record_change(key);
+            }
+
+            /// Called when the object in this cell is modified.
+            void notify_touched_() override {
+                cell<T>::notify_touched_();
+
+                universe<T,D>& u = get_universe_();
+                if (u.journal_enabled()) u.record_change(get_key_());
+            }
+
+            /// Called when the object in this cell is destroyed.
+            /** Will let the universe destroy it when no other thread can access it.
+            **/
+            void dispose_(std::unique_ptr<T> obj) override {
+                get_universe_().retire_object(std::move(obj));
+            }
+
+            /// Return the universe this cell belongs to.
+            /** \note Contrary to the other cells, this does not walk up the quad-tree.
             **/
-            void notify_empty_() override {
-                cell<T>::notify_empty_();
-                parent.on_cell_empty_();
+            universe<T,D>& get_universe_() const {
+                return parent.split.load()->universe_;
+            }
+
+            /// Return the Morton code of this cell.
+            std::uint64_t get_key_() const {
+                std::uint64_t key = 0;
+                parent.get_key_(*this, key);
+                return key;
             }
         };
 
@@ -581,14 +1831,22 @@ namespace space {
             /// @copydoc space::impl::any_cell::empty
             bool empty() const { return split == nullptr; }
 
+            /// @copydoc space::impl::any_cell::count
+            std::size_t count() const {
+                split_cell<T,1,D>* s = split;
+                return s ? s->count.load(std::memory_order_relaxed) : 0;
+            }
+
             /// @copydoc space::impl::any_cell::make_split
-            void make_split() { split.reset(new split_cell<T,1,D>(*this)); }
+            void make_split(universe<T,D>& u) {
+                split = new (u.template split_pool<1>().allocate()) split_cell<T,1,D>(u, *this);
+            }
 
             /// The universe this cell belongs to.
             universe<T,D>& parent;
 
-            /// The split sub-cells, if any.
-            std::unique_ptr<split_cell<T,1,D>> split;
+            /// @copydoc space::impl::any_cell::split
+            published_ptr<split_cell<T,1,D>> split;
 
         private :
             explicit any_cell(universe<T,D>& parent) : parent(parent) {}
@@ -597,20 +1855,34 @@ namespace space {
             any_cell(any_cell&&) = default;
             any_cell& operator=(any_cell&&) = default;
 
-            /// @copydoc space::impl::any_cell::on_cell_empty_
-            void on_cell_empty_() {
-                for (auto& c : split->children) {
-                    if (!c.empty()) return;
-                }
+            /// @copydoc space::impl::any_cell::get_universe_
+            universe<T,D>& get_universe_() {
+                return parent;
+            }
 
-                split.reset();
+            /// @copydoc space::impl::any_cell::notify_count_
+            void notify_count_(const any_cell<T,2,D>& c, bool filled, std::uint64_t& key) {
+                split_cell<T,1,D>* s = split;
+                add_count_(s->count, filled);
+                key |= sub_key_(c, s);
+            }
+
+            /// @copydoc space::impl::any_cell::get_key_
+            void get_key_(const any_cell<T,2,D>& c, std::uint64_t& key) const {
+                key |= sub_key_(c, split.load());
+            }
+
+            /// @copydoc space::impl::any_cell::sub_key_
+            static std::uint64_t sub_key_(const any_cell<T,2,D>& c, const split_cell<T,1,D>* s) {
+                static const std::size_t shift = 2*(D-2);
+                return std::uint64_t(&c - &s->children[0]) << shift;
             }
 
             /// @copydoc space::impl::any_cell::get_coordinates_
             void get_coordinates_(const any_cell<T,2,D>& c, vec_t& pos) const {
                 static const std::size_t half_size = 1 << (D-2);
 
-                std::size_t i = &c - &split->children[0];
+                std::size_t i = &c - &split.load()->children[0];
                 switch (i) {
                 case sub_cell::TL :                                         break;
                 case sub_cell::TR : pos.x += half_size;                     break;
@@ -631,9 +1903,10 @@ namespace space {
 
             /// @copydoc space::impl::any_cell::try_reach_
             const any_cell<T,2,D>* try_reach_(const any_cell<T,2,D>& c, direction dir) const {
+                const split_cell<T,1,D>* s = split;
                 std::size_t next_id;
-                if (get_cell_id(&c - &split->children[0], dir, next_id)) {
-                    return &split->children[next_id];
+                if (get_cell_id(&c - &s->children[0], dir, next_id)) {
+                    return &s->children[next_id];
                 } else {
                     return nullptr;
                 }
@@ -662,6 +1935,11 @@ namespace space {
                 return nullptr;
             }
 
+            /// Return the content of this cell, or nullptr if it is empty.
+            const T* try_content() const {
+                return cell<T>::try_content_();
+            }
+
             /// @copydoc space::impl::any_cell::parent
             universe<T,1>& parent;
 
@@ -673,11 +1951,82 @@ namespace space {
             any_cell& operator=(any_cell&&) = default;
         };
 
+        /// Holds one pool of split cells per level of the quad-tree.
+        /** The pool of level N is found in the base class split_pool_list<T,N,D>.
+        **/
+        template<typename T, std::size_t N, std::size_t D>
+        struct split_pool_list : split_pool_list<T,N+1,D> {
+            ctl::slab_pool<split_cell<T,N,D>> pool;
+
+            /// Return the number of split cells allocated from this level and the next ones.
+            std::size_t size() const {
+                return pool.size() + split_pool_list<T,N+1,D>::size();
+            }
+
+            /// Add the memory used by this level and the next ones to the provided statistics.
+            void memory_usage(memory_stats& stats) const {
+                using pool_type = ctl::slab_pool<split_cell<T,N,D>>;
+                stats.split_cells[N-1] = pool.size();
+                stats.structure_bytes += pool.size()*pool_type::block_size();
+                stats.reserved_bytes  += pool.capacity()*pool_type::block_size();
+                split_pool_list<T,N+1,D>::memory_usage(stats);
+            }
+        };
+
+        /// Unit cells are never split.
+        template<typename T, std::size_t D>
+        struct split_pool_list<T,D,D> {
+            std::size_t size() const {
+                return 0;
+            }
+
+            void memory_usage(memory_stats&) const {}
+        };
+
         /// Universe of depth D.
         template<typename T, std::size_t D>
         struct universe : public space::universe<T> {
+            friend space::cursor<T,D>;
+
             universe() : root_(*this) {}
 
+            ~universe() {
+                // Destroy all the cells (and the objects they contain), but do not bother
+                // giving their memory back one by one: the pools will release it all at once.
+                destroy_(root_);
+                for (auto& r : retired_cells_) {
+                    destroy_retired_<1>(r);
+                }
+            }
+
+            /// Return the pool from which the split cells of the Nth level are allocated.
+            template<std::size_t N>
+            ctl::slab_pool<split_cell<T,N,D>>& split_pool() {
+                return static_cast<split_pool_list<T,N,D>&>(pools_).pool;
+            }
+
+            /// Schedule the unit cell with the provided Morton code for collapse.
+            void schedule_collapse(std::uint64_t key) {
+                collapse_queue_.push(key);
+            }
+
+            /// Record a change in the unit cell with the provided Morton code.
+            void record_change(std::uint64_t key) {
+                this->record_change_(key);
+            }
+
+            /// Destroy an object that has been removed from its cell.
+            /** \note If concurrent reads are enabled, the object is only destroyed once no
+                      reader can access it anymore.
+            **/
+            void retire_object(std::unique_ptr<T> obj) {
+                if (concurrent_reads_) {
+                    retired_objects_.push_back(retired_object{
+                        this->epoch_manager_().epoch(), std::move(obj)
+                    });
+                }
+            }
+
             /// @copydoc space::universe::depth
             std::size_t depth() const override {
                 return D;
@@ -690,30 +2039,22 @@ namespace space {
 
             /// @copydoc space::universe::reach
             cell<T>& reach(const space::vec_t& spos) override {
-                static const pos_t half_size = 1 << (D-2);
+                static const pos_t half_size = (pos_t(1) << (D-1))/2;
+                if (!this->contains(spos)) throw space::exception::invalid_position(spos);
                 vec_t pos(spos + space::vec_t(half_size, half_size));
-                if (!check_position_(pos)) throw space::exception::invalid_position(spos);
 
                 return reach_(root_, pos);
             }
 
             /// @copydoc space::universe::try_reach
             const cell<T>* try_reach(const space::vec_t& spos) const override {
-                static const pos_t half_size = 1 << (D-2);
+                static const pos_t half_size = (pos_t(1) << (D-1))/2;
+                if (!this->contains(spos)) return nullptr;
                 vec_t pos(spos + space::vec_t(half_size, half_size));
-                if (!check_position_(pos)) return nullptr;
 
                 return try_reach_(root_, pos);
             }
 
-            /// @copydoc space::universe::clip
-            void clip(const axis_aligned_box2d& box,
-                ctl::sorted_vector<const cell<T>&>& list) const override {
-
-                static const pos_t half_size = 1 << (D-2);
-                clip_(root_, box + vec2d(half_size, half_size), list);
-            }
-
             /// @copydoc space::universe::for_each_cell
             void for_each_cell(const ctl::delegate<bool(T&)>& callback) override {
                 const_cast<const universe*>(this)->for_each_cell_(root_,
@@ -726,10 +2067,184 @@ namespace space {
                 for_each_cell_(root_, callback);
             }
 
+            /// @copydoc space::universe::parallel_for_each_cell
+            void parallel_for_each_cell(const ctl::delegate<void(T&)>& callback,
+                std::size_t split_level) override {
+                const_cast<const universe*>(this)->parallel_for_each_cell(
+                    [&callback](const T& t) { callback(const_cast<T&>(t)); }, split_level
+                );
+            }
+
+            /// @copydoc space::universe::parallel_for_each_cell
+            void parallel_for_each_cell(const ctl::delegate<void(const T&)>& callback,
+                std::size_t split_level) const override {
+                ctl::delegate<bool(const T&)> cb = [&callback](const T& t) {
+                    callback(t); return true;
+                };
+
+                tbb::task_group tasks;
+                parallel_for_each_cell_(root_, cb, split_level + 1, tasks);
+                tasks.wait();
+            }
+
+            /// @copydoc space::universe::bulk_fill
+            std::size_t bulk_fill(
+                std::vector<typename space::universe<T>::positioned_object>& objects) override {
+
+                auto items = sort_batch(objects, *this);
+                if (!items.empty()) bulk_fill_(root_, items.data(), items.data() + items.size());
+
+                std::size_t nfail = 0;
+                for (auto& o : objects) {
+                    if (o.second) ++nfail;
+                }
+
+                return nfail;
+            }
+
+            /// @copydoc space::universe::collapse
+            std::size_t collapse() override {
+                std::size_t bytes = 0;
+                std::vector<std::uint64_t> keys = collapse_queue_.pop(collapse_delay_);
+                if (!keys.empty() && collapse_(root_, keys.data(), keys.data() + keys.size(), bytes)) {
+                    bytes += unsplit_(root_);
+                }
+
+                if (!retired_cells_.empty() || !retired_objects_.empty()) {
+                    this->epoch_manager_().advance();
+                    reclaim_(this->epoch_manager_().safe_epoch());
+                }
+
+                reclaimed_bytes_ += bytes;
+                return bytes;
+            }
+
+            /// @copydoc space::universe::set_concurrent_reads
+            void set_concurrent_reads(bool enabled) override {
+                concurrent_reads_ = enabled;
+                if (!enabled) reclaim_(std::uint64_t(-1));
+            }
+
+            /// @copydoc space::universe::concurrent_reads
+            bool concurrent_reads() const override {
+                return concurrent_reads_;
+            }
+
+            /// @copydoc space::universe::set_collapse_delay
+            void set_collapse_delay(std::size_t delay) override {
+                collapse_delay_ = delay;
+            }
+
+            /// @copydoc space::universe::collapse_delay
+            std::size_t collapse_delay() const override {
+                return collapse_delay_;
+            }
+
+            /// @copydoc space::universe::node_count
+            std::size_t node_count() const override {
+                return pools_.size();
+            }
+
+            /// @copydoc space::universe::reclaimed_bytes
+            std::size_t reclaimed_bytes() const override {
+                return reclaimed_bytes_;
+            }
+
+            /// @copydoc space::universe::object_count
+            std::size_t object_count() const override {
+                return count_(root_);
+            }
+
+            /// @copydoc space::universe::object_count
+            std::size_t object_count(const space::vec_t& spos, std::size_t level) const override {
+                static const pos_t half_size = (pos_t(1) << (D-1))/2;
+                if (!this->contains(spos)) return 0;
+                vec_t pos(spos + space::vec_t(half_size, half_size));
+
+                return object_count_(root_, pos, std::min(level, D-1));
+            }
+
+            /// @copydoc space::universe::density_map
+            void density_map(std::size_t level, std::vector<std::size_t>& map) const override {
+                level = std::min(level, D-1);
+                map.assign(std::size_t(1) << 2*level, 0);
+                density_map_(root_, 0, 0, level, map);
+            }
+
+        protected :
+            /// @copydoc space::universe::memory_usage_
+            void memory_usage_(memory_stats& stats) const override {
+                stats.split_cells.assign(D-1, 0);
+                stats.structure_bytes += sizeof(*this);
+                stats.reserved_bytes  += sizeof(*this);
+                pools_.memory_usage(stats);
+                collapse_queue_.memory_usage(stats);
+
+                // Retired split cells are still counted by the pools until reclaimed
+                stats.structure_bytes += retired_cells_.size()*sizeof(retired_cell) +
+                    retired_objects_.size()*sizeof(retired_object);
+                stats.reserved_bytes += retired_cells_.capacity()*sizeof(retired_cell) +
+                    retired_objects_.capacity()*sizeof(retired_object);
+
+                // Unit cells are allocated four at a time, along with their parent
+                stats.unit_cells = D > 1 ? 4*stats.split_cells[D-2] : 1;
+                stats.occupied_cells = count_(root_);
+            }
+
+            /// @copydoc space::universe::next_cell_in_
+            const cell<T>* next_cell_in_(const vec_t& pmin, const vec_t& pmax,
+                std::uint64_t& key, std::size_t&) const override {
+                return next_cell_in_(root_, vec_t(0,0), 0, pmin, pmax, key, false);
+            }
+
+            /// @copydoc space::universe::try_reach_sorted_
+            void try_reach_sorted_(const std::vector<std::uint64_t>& keys,
+                std::vector<const cell<T>*>& cells) const override {
+                cells.resize(keys.size());
+                if (!keys.empty()) {
+                    try_reach_sorted_(&root_, keys.data(), keys.data() + keys.size(),
+                        cells.data());
+                }
+            }
+
         private :
+            /// The memory pools of the split cells.
+            split_pool_list<T,1,D> pools_;
+
             /// The root cell of the quad-tree.
             any_cell<T,1,D> root_;
 
+            /// The unit cells that have been emptied, waiting to be collapsed.
+            collapse_queue collapse_queue_;
+
+            /// See set_collapse_delay().
+            std::size_t collapse_delay_ = space::universe<T>::default_collapse_delay;
+
+            /// See reclaimed_bytes().
+            std::size_t reclaimed_bytes_ = 0;
+
+            /// See set_concurrent_reads().
+            bool concurrent_reads_ = false;
+
+            /// A split cell that has been removed from the quad-tree, see collapse().
+            struct retired_cell {
+                std::uint64_t epoch;
+                std::size_t level;
+                void* split;
+            };
+
+            /// An object that has been removed from its cell, see retire_object().
+            struct retired_object {
+                std::uint64_t epoch;
+                std::unique_ptr<T> obj;
+            };
+
+            /// The split cells that are waiting for the readers to release them.
+            std::vector<retired_cell> retired_cells_;
+
+            /// The objects that are waiting for the readers to release them.
+            std::vector<retired_object> retired_objects_;
+
             /// Return the id of the cell in the Nth level that contains
             /// the provided position, and modify this position for future
             /// calls in order to always clamp it within what is accessible
@@ -742,14 +2257,6 @@ namespace space {
                 return dx + 2*dy;
             }
 
-            /// Check that the provided position is valid.
-            /** I.e. it doesn't go past the boundaries of this universe.
-            **/
-            bool check_position_(const vec_t& pos) const {
-                static const pos_t size = 1 << (D-1);
-                return pos.x < size && pos.y < size;
-            }
-
             /// Recursively traverse the quad-tree to reach the provided position.
             /** \param c   The cell to dive in
                 \param pos The position to look for within that cell
@@ -757,7 +2264,7 @@ namespace space {
             **/
             template<std::size_t N>
             cell<T>& reach_(any_cell<T,N,D>& c, vec_t& pos) {
-                if (!c.split) c.make_split();
+                if (!c.split) c.make_split(*this);
                 return reach_(c.split->children[get_id_<N>(pos)], pos);
             }
 
@@ -777,8 +2284,9 @@ namespace space {
             **/
             template<std::size_t N>
             const cell<T>* try_reach_(const any_cell<T,N,D>& c, vec_t& pos) const {
-                if (!c.split) return nullptr;
-                return try_reach_(c.split->children[get_id_<N>(pos)], pos);
+                const split_cell<T,N,D>* s = c.split;
+                if (!s) return nullptr;
+                return try_reach_(s->children[get_id_<N>(pos)], pos);
             }
 
             /// Recursively traverse the quad-tree to reach the provided position.
@@ -790,75 +2298,1176 @@ namespace space {
                 return &c;
             }
 
-            /// Recursively traverse the quad-tree to select the cells within the provided box.
-            /** \param c    The cell to dive in
-                \param box  The box within which to select the cells
-                \param list The container within which to store the selected cells
+            /// Recursively traverse the quad-tree to find the next non-empty cell inside a box.
+            /** \param c      The cell to dive in
+                \param origin The top-left corner of this cell
+                \param kbase  The Morton code of the top-left corner of this cell
+                \param pmin   The top-left corner of the box (inclusive)
+                \param pmax   The bottom-right corner of the box (inclusive)
+                \param key    The Morton code from which to start the search
+                \param inside 'true' if this cell is known to lie fully inside the box
             **/
             template<std::size_t N>
-            void clip_(const any_cell<T,N,D>& c, const axis_aligned_box2d& box,
-                ctl::sorted_vector<const cell<T>&>& list) const {
-
-                static const double size = 1 << (D-N);
-                static const axis_aligned_box2d cell_boxes[4] = {
-                    axis_aligned_box2d(vec2d(   0.0,    0.0), vec2d(size/2, size/2)),
-                    axis_aligned_box2d(vec2d(size/2,    0.0), vec2d(  size, size/2)),
-                    axis_aligned_box2d(vec2d(   0.0, size/2), vec2d(size/2,   size)),
-                    axis_aligned_box2d(vec2d(size/2, size/2), vec2d(  size,   size))
-                };
-                static const vec2d offsets[4] = {
-                    vec2d(   0.0,    0.0),
-                    vec2d(size/2,    0.0),
-                    vec2d(   0.0, size/2),
-                    vec2d(size/2, size/2)
-                };
-
-                if (!c.split) return;
-                for (std::size_t i : range(c.split->children)) {
-                    if (box.contains(cell_boxes[i])) {
-                        clip_(c.split->children[i], box - offsets[i], list);
+            const cell<T>* next_cell_in_(const any_cell<T,N,D>& c, const vec_t& origin,
+                std::uint64_t kbase, const vec_t& pmin, const vec_t& pmax, std::uint64_t& key,
+                bool inside) const {
+
+                static const pos_t half_size = pos_t(1) << (D-N-1);
+                static const std::uint64_t nkey = std::uint64_t(half_size)*half_size;
+
+                const split_cell<T,N,D>* s = c.split;
+                if (!s || s->count.load(std::memory_order_relaxed) == 0) return nullptr;
+                for (std::size_t id = 0; id < 4; ++id) {
+                    std::uint64_t skey = kbase + id*nkey;
+                    if (skey + nkey <= key) continue;
+
+                    vec_t sorigin(origin.x + (id%2)*half_size, origin.y + (id/2)*half_size);
+                    bool sinside = inside;
+                    if (!sinside) {
+                        if (sorigin.x > pmax.x || sorigin.x + (half_size-1) < pmin.x ||
+                            sorigin.y > pmax.y || sorigin.y + (half_size-1) < pmin.y) continue;
+
+                        sinside = pmin.x <= sorigin.x && sorigin.x + (half_size-1) <= pmax.x &&
+                                  pmin.y <= sorigin.y && sorigin.y + (half_size-1) <= pmax.y;
                     }
+
+                    const cell<T>* r = next_cell_in_(s->children[id], sorigin, skey,
+                        pmin, pmax, key, sinside);
+                    if (r) return r;
                 }
+
+                return nullptr;
             }
 
-            /// Recursively traverse the quad-tree to select the cells within the provided box.
-            /** \param c    The cell to dive in
-                \param box  The box within which to select the cells
-                \param list The container within which to store the selected cells
+            /// Recursively traverse the quad-tree to find the next non-empty cell inside a box.
+            /** \param c      The cell to dive in
+                \param kbase  The Morton code of this cell
+                \param key    Will be set to the Morton code of this cell if it is not empty
             **/
-            void clip_(const any_cell<T,D,D>& c, const axis_aligned_box2d& box,
-                ctl::sorted_vector<const cell<T>&>& list) const {
+            const cell<T>* next_cell_in_(const any_cell<T,D,D>& c, const vec_t& origin,
+                std::uint64_t kbase, const vec_t& pmin, const vec_t& pmax, std::uint64_t& key,
+                bool inside) const {
 
-                if (!c.empty()) {
-                    list.insert(c);
+                if (c.empty()) return nullptr;
+                key = kbase;
+                return &c;
+            }
+
+            /// Return the number of objects in a cell.
+            template<std::size_t N>
+            static std::size_t count_(const any_cell<T,N,D>& c) {
+                return c.count();
+            }
+
+            /// Return the number of objects in a cell.
+            static std::size_t count_(const any_cell<T,D,D>& c) {
+                return c.empty() ? 0 : 1;
+            }
+
+            /// Recursively traverse the quad-tree to count the objects of a region.
+            /** \param c     The cell to dive in
+                \param pos   A position inside the region
+                \param level The level of the region
+            **/
+            template<std::size_t N>
+            std::size_t object_count_(const any_cell<T,N,D>& c, const vec_t& pos,
+                std::size_t level) const {
+
+                static const std::size_t shift = D-N-1;
+
+                const split_cell<T,N,D>* s = c.split;
+                if (!s) return 0;
+
+                std::size_t count = s->count.load(std::memory_order_relaxed);
+                if (N-1 == level || count == 0) return count;
+
+                std::size_t id = ((pos.x >> shift) & 1) + 2*((pos.y >> shift) & 1);
+                return object_count_(s->children[id], pos, level);
+            }
+
+            /// Recursively traverse the quad-tree to count the objects of a region.
+            /** \param c The cell to dive in
+            **/
+            std::size_t object_count_(const any_cell<T,D,D>& c, const vec_t& pos,
+                std::size_t level) const {
+                return count_(c);
+            }
+
+            /// Recursively traverse the quad-tree to count the objects of each region.
+            /** \param c     The cell to dive in
+                \param x     The horizontal position of this cell, in units of regions
+                \param y     The vertical position of this cell, in units of regions
+                \param level The level of the regions
+                \param map   The container in which to store the number of objects
+            **/
+            template<std::size_t N>
+            void density_map_(const any_cell<T,N,D>& c, std::size_t x, std::size_t y,
+                std::size_t level, std::vector<std::size_t>& map) const {
+
+                const split_cell<T,N,D>* s = c.split;
+                if (!s) return;
+
+                std::size_t count = s->count.load(std::memory_order_relaxed);
+                if (count == 0) return;
+
+                if (N-1 == level) {
+                    map[x + (y << level)] = count;
+                    return;
+                }
+
+                for (std::size_t id = 0; id < 4; ++id) {
+                    density_map_(s->children[id], 2*x + id%2, 2*y + id/2, level, map);
                 }
             }
 
+            /// Recursively traverse the quad-tree to count the objects of each region.
+            /** \param c     The cell to dive in
+                \param x     The horizontal position of this cell, in units of regions
+                \param y     The vertical position of this cell, in units of regions
+                \param level The level of the regions
+                \param map   The container in which to store the number of objects
+            **/
+            void density_map_(const any_cell<T,D,D>& c, std::size_t x, std::size_t y,
+                std::size_t level, std::vector<std::size_t>& map) const {
+
+                if (!c.empty()) map[x + (y << level)] = 1;
+            }
+
             /// Recursively traverse the quad-tree to call a function on each non-empty cell.
             /** \param c        The cell to dive in
                 \param callback The function
+                \return 'false' if the callback asked to stop the iteration, 'true' otherwise
             **/
             template<std::size_t N>
-            void for_each_cell_(const any_cell<T,N,D>& c,
+            bool for_each_cell_(const any_cell<T,N,D>& c,
                 const ctl::delegate<bool(const T&)>& callback) const {
 
-                if (!c.split) return;
-                for (auto& sc : c.split->children) {
-                    for_each_cell_(sc, callback);
+                const split_cell<T,N,D>* s = c.split;
+                if (!s || s->count.load(std::memory_order_relaxed) == 0) return true;
+                for (auto& sc : s->children) {
+                    if (!for_each_cell_(sc, callback)) return false;
                 }
+
+                return true;
             }
 
             /// Recursively traverse the quad-tree to call a function on each non-empty cell.
             /** \param c        The cell to dive in
                 \param callback The function
+                \return 'false' if the callback asked to stop the iteration, 'true' otherwise
             **/
-            void for_each_cell_(const any_cell<T,D,D>& c,
+            bool for_each_cell_(const any_cell<T,D,D>& c,
                 const ctl::delegate<bool(const T&)>& callback) const {
 
-                if (!c.empty()) callback(c.content());
+                const T* obj = c.try_content();
+                if (!obj) return true;
+                return callback(*obj);
             }
-        };
-    }
+
+            /// Recursively traverse the quad-tree to spawn one task per sub-tree.
+            /** \param c        The cell to dive in
+                \param callback The function
+                \param level    The level at which the sub-trees are handed to tasks
+                \param tasks    The task group in which to spawn the tasks
+            **/
+            template<std::size_t N>
+            void parallel_for_each_cell_(const any_cell<T,N,D>& c,
+                const ctl::delegate<bool(const T&)>& callback, std::size_t level,
+                tbb::task_group& tasks) const {
+
+                const split_cell<T,N,D>* s = c.split;
+                if (!s || s->count.load(std::memory_order_relaxed) == 0) return;
+
+                if (N >= level) {
+                    tasks.run([this, &c, &callback]() { for_each_cell_(c, callback); });
+                    return;
+                }
+
+                for (auto& sc : s->children) {
+                    parallel_for_each_cell_(sc, callback, level, tasks);
+                }
+            }
+
+            /// Recursively traverse the quad-tree to spawn one task per sub-tree.
+            /** \param c        The cell to dive in
+                \param callback The function
+            **/
+            void parallel_for_each_cell_(const any_cell<T,D,D>& c,
+                const ctl::delegate<bool(const T&)>& callback, std::size_t,
+                tbb::task_group&) const {
+
+                const T* obj = c.try_content();
+                if (obj) callback(*obj);
+            }
+
+            /// Recursively traverse the quad-tree to place a sorted batch of objects.
+            /** \param c     The cell to dive in
+                \param first The first object of the batch that lies in this cell
+                \param last  Past the last object of the batch that lies in this cell
+                \note Will split a cell if needed in order to reach the positions.
+            **/
+            template<std::size_t N>
+            void bulk_fill_(any_cell<T,N,D>& c, bulk_item<T>* first, bulk_item<T>* last) {
+                static const std::size_t shift = 2*(D-N-1);
+
+                if (!c.split) c.make_split(*this);
+
+                // The objects are sorted, so the ones that belong to each sub-cell are contiguous
+                for (std::size_t id = 0; id < 4 && first != last; ++id) {
+                    bulk_item<T>* next = first;
+                    while (next != last && ((next->key >> shift) & 3) == id) ++next;
+                    if (next != first) bulk_fill_(c.split->children[id], first, next);
+                    first = next;
+                }
+            }
+
+            /// Recursively traverse the quad-tree to place a sorted batch of objects.
+            /** \param c     The cell to dive in
+                \param first The first object of the batch that lies in this cell
+                \param last  Past the last object of the batch that lies in this cell
+            **/
+            void bulk_fill_(any_cell<T,D,D>& c, bulk_item<T>* first, bulk_item<T>* last) {
+                if (c.empty()) c.fill(std::move(first->obj->second));
+            }
+
+            /// Recursively traverse the quad-tree to find the cells of a sorted list of codes.
+            /** \param c     The cell to dive in, or nullptr if it does not exist
+                \param first The first Morton code that lies in this cell
+                \param last  Past the last Morton code that lies in this cell
+                \param out   Where to write the cells found for [first,last), in the same order
+                \note The codes are sorted, so that each cell is only visited once.
+            **/
+            template<std::size_t N>
+            void try_reach_sorted_(const any_cell<T,N,D>* c, const std::uint64_t* first,
+                const std::uint64_t* last, const cell<T>** out) const {
+
+                static const std::size_t shift = 2*(D-N-1);
+
+                if (!c || !c->split) {
+                    std::fill(out, out + (last - first), nullptr);
+                    return;
+                }
+
+                // The codes are sorted, so the ones that belong to each sub-cell are contiguous
+                for (std::size_t id = 0; id < 4 && first != last; ++id) {
+                    const std::uint64_t* next = first;
+                    while (next != last && ((*next >> shift) & 3) == id) ++next;
+                    if (next != first) {
+                        try_reach_sorted_(&c->split->children[id], first, next, out);
+                        out += next - first;
+                    }
+                    first = next;
+                }
+            }
+
+            /// Recursively traverse the quad-tree to find the cells of a sorted list of codes.
+            /** \param c     The cell to dive in, or nullptr if it does not exist
+                \param first The first Morton code that lies in this cell
+                \param last  Past the last Morton code that lies in this cell
+                \param out   Where to write the cells found for [first,last)
+                \note All the codes are the same, since this is a unit cell.
+            **/
+            void try_reach_sorted_(const any_cell<T,D,D>* c, const std::uint64_t* first,
+                const std::uint64_t* last, const cell<T>** out) const {
+                std::fill(out, out + (last - first), c);
+            }
+
+            /// Recursively traverse the quad-tree to delete the empty cells along some paths.
+            /** \param c     The cell to dive in
+                \param first The Morton code of the first unit cell that lies in this cell
+                \param last  Past the Morton code of the last unit cell that lies in this cell
+                \param bytes Incremented by the number of bytes given back to the pools
+                \return 'true' if none of the sub-cells of this cell is occupied after the
+                        collapse of the paths, in which case the caller should unsplit it
+                \note The codes are sorted, so that each cell is only visited once. Only the
+                      top-most cells that can be unsplit are actually unsplit, so that whole
+                      sub-trees are removed from the quad-tree at once.
+            **/
+            template<std::size_t N>
+            bool collapse_(any_cell<T,N,D>& c, const std::uint64_t* first,
+                const std::uint64_t* last, std::size_t& bytes) {
+
+                static const std::size_t shift = 2*(D-N-1);
+
+                split_cell<T,N,D>* s = c.split;
+                if (!s) return true;
+
+                bool empty[4];
+                for (std::size_t id = 0; id < 4; ++id) {
+                    const std::uint64_t* next = first;
+                    while (next != last && ((*next >> shift) & 3) == id) ++next;
+
+                    if (next != first) {
+                        empty[id] = collapse_(s->children[id], first, next, bytes);
+                    } else {
+                        empty[id] = s->children[id].empty();
+                    }
+
+                    first = next;
+                }
+
+                if (empty[0] && empty[1] && empty[2] && empty[3]) return true;
+
+                for (std::size_t id = 0; id < 4; ++id) {
+                    if (empty[id]) bytes += unsplit_(s->children[id]);
+                }
+
+                return false;
+            }
+
+            /// Recursively traverse the quad-tree to delete the empty cells along some paths.
+            /** \param c The cell to dive in
+                \return 'true' if this cell is empty
+            **/
+            bool collapse_(any_cell<T,D,D>& c, const std::uint64_t*, const std::uint64_t*,
+                std::size_t&) {
+                return c.empty();
+            }
+
+            /// Remove the sub-cells of a cell from the quad-tree.
+            /** \param c The cell to unsplit
+                \return The number of bytes given back to the pools
+                \note If concurrent reads are enabled, the memory of the sub-cells is only
+                      given back once no reader can access it anymore.
+            **/
+            template<std::size_t N>
+            std::size_t unsplit_(any_cell<T,N,D>& c) {
+                split_cell<T,N,D>* s = c.split;
+                if (!s) return 0;
+
+                c.split = nullptr;
+                if (concurrent_reads_) {
+                    retired_cells_.push_back(retired_cell{
+                        this->epoch_manager_().epoch(), N, s
+                    });
+                    return split_bytes_(*s);
+                } else {
+                    return free_split_(*s);
+                }
+            }
+
+            /// Remove the sub-cells of a cell from the quad-tree.
+            /** \param c The cell to unsplit
+                \return The number of bytes given back to the pools
+            **/
+            std::size_t unsplit_(any_cell<T,D,D>& c) {
+                return 0;
+            }
+
+            /// Return the number of bytes used by a split cell and all its sub-cells.
+            template<std::size_t N>
+            static std::size_t split_bytes_(const split_cell<T,N,D>& s) {
+                std::size_t bytes = ctl::slab_pool<split_cell<T,N,D>>::block_size();
+                for (auto& sc : s.children) {
+                    bytes += split_bytes_(sc);
+                }
+
+                return bytes;
+            }
+
+            /// Return the number of bytes used by the sub-cells of a cell.
+            template<std::size_t N>
+            static std::size_t split_bytes_(const any_cell<T,N,D>& c) {
+                const split_cell<T,N,D>* s = c.split;
+                return s ? split_bytes_(*s) : 0;
+            }
+
+            /// Return the number of bytes used by the sub-cells of a cell.
+            static std::size_t split_bytes_(const any_cell<T,D,D>& c) {
+                return 0;
+            }
+
+            /// Destroy a split cell and all its sub-cells, and give their memory back to the pools.
+            /** \return The number of bytes given back to the pools
+            **/
+            template<std::size_t N>
+            std::size_t free_split_(split_cell<T,N,D>& s) {
+                std::size_t bytes = ctl::slab_pool<split_cell<T,N,D>>::block_size();
+                for (auto& sc : s.children) {
+                    bytes += free_cell_(sc);
+                }
+
+                s.~split_cell();
+                split_pool<N>().deallocate(&s);
+                return bytes;
+            }
+
+            /// Destroy the sub-cells of a cell, and give their memory back to the pools.
+            template<std::size_t N>
+            std::size_t free_cell_(any_cell<T,N,D>& c) {
+                split_cell<T,N,D>* s = c.split;
+                return s ? free_split_(*s) : 0;
+            }
+
+            /// Destroy the sub-cells of a cell, and give their memory back to the pools.
+            std::size_t free_cell_(any_cell<T,D,D>& c) {
+                return 0;
+            }
+
+            /// Give back the memory that has been retired before the provided epoch.
+            void reclaim_(std::uint64_t epoch) {
+                auto cell_last = std::remove_if(retired_cells_.begin(), retired_cells_.end(),
+                    [&](retired_cell& r) {
+                        if (r.epoch >= epoch) return false;
+                        free_retired_<1>(r);
+                        return true;
+                    }
+                );
+                retired_cells_.erase(cell_last, retired_cells_.end());
+
+                auto obj_last = std::remove_if(retired_objects_.begin(), retired_objects_.end(),
+                    [&](const retired_object& r) { return r.epoch < epoch; });
+                retired_objects_.erase(obj_last, retired_objects_.end());
+            }
+
+            /// Give back the memory of a retired split cell.
+            template<std::size_t N>
+            void free_retired_(const retired_cell& r) {
+                if constexpr (N < D) {
+                    if (r.level == N) {
+                        free_split_(*static_cast<split_cell<T,N,D>*>(r.split));
+                    } else {
+                        free_retired_<N+1>(r);
+                    }
+                }
+            }
+
+            /// Destroy a retired split cell, without giving its memory back to the pools.
+            template<std::size_t N>
+            void destroy_retired_(const retired_cell& r) {
+                if constexpr (N < D) {
+                    if (r.level == N) {
+                        auto* s = static_cast<split_cell<T,N,D>*>(r.split);
+                        for (auto& sc : s->children) {
+                            destroy_(sc);
+                        }
+                        s->~split_cell();
+                    } else {
+                        destroy_retired_<N+1>(r);
+                    }
+                }
+            }
+
+            /// Recursively destroy all the split cells of the quad-tree.
+            /** \param c The cell to dive in
+                \note The memory of the cells is not given back to the pools.
+            **/
+            template<std::size_t N>
+            void destroy_(any_cell<T,N,D>& c) {
+                split_cell<T,N,D>* s = c.split;
+                if (!s) return;
+                for (auto& sc : s->children) {
+                    destroy_(sc);
+                }
+
+                s->~split_cell();
+                c.split = nullptr;
+            }
+
+            /// Recursively destroy all the split cells of the quad-tree.
+            /** \param c The cell to dive in
+            **/
+            void destroy_(any_cell<T,D,D>& c) {}
+        };
+
+        /// A unit cell of a linear universe.
+        template<typename T>
+        struct linear_cell : public space::cell<T> {
+            friend linear_universe<T>;
+
+            /// @copydoc space::cell::get_coordinates
+            space::vec_t get_coordinates() const override {
+                return parent.to_external_(morton_decode(key));
+            }
+
+            /// @copydoc space::cell::reach
+            cell<T>* reach(direction dir) override {
+                vec_t pos;
+                if (!parent.get_neighbor_(key, dir, pos)) return nullptr;
+                return &parent.reach_(morton_encode(pos));
+            }
+
+            /// @copydoc space::cell::try_reach
+            const cell<T>* try_reach(direction dir) const override {
+                vec_t pos;
+                if (!parent.get_neighbor_(key, dir, pos)) return nullptr;
+                return parent.try_reach_(morton_encode(pos));
+            }
+
+            /// The Morton code of this cell.
+            const std::uint64_t key;
+
+            /// The universe this cell belongs to.
+            linear_universe<T>& parent;
+
+        private :
+            linear_cell(linear_universe<T>& parent, std::uint64_t key) :
+                key(key), parent(parent) {}
+            linear_cell(const linear_cell&) = delete;
+            linear_cell& operator=(const linear_cell&) = delete;
+
+            /// Called when the content of this cell is destroyed.
+            /** Will schedule this cell for collapse, see space::universe::collapse().
+            **/
+            void notify_empty_(bool nodelete) override {
+                cell<T>::notify_empty_(nodelete);
+                --parent.object_count_;
+                parent.record_change_(key);
+                if (!nodelete) parent.collapse_queue_.push(key);
+            }
+
+            /// Called when an object is put in this cell.
+            void notify_filled_() override {
+                cell<T>::notify_filled_();
+                ++parent.object_count_;
+                parent.record_change_(key);
+            }
+
+            /// Called when the object in this cell is modified.
+            void notify_touched_() override {
+                cell<T>::notify_touched_();
+                parent.record_change_(key);
+            }
+        };
+
+        /// Universe stored as a linear quad-tree, i.e. as a list of cells sorted by Morton code.
+        /** The depth is only known at runtime.
+        **/
+        template<typename T>
+        struct linear_universe : public space::universe<T> {
+            friend linear_cell<T>;
+
+            explicit linear_universe(std::size_t depth) : depth_(depth) {
+                if (depth_ < 1 || depth_ > max_linear_depth) {
+                    throw space::exception::invalid_depth(depth_);
+                }
+            }
+
+            ~linear_universe() {
+                for (auto* c : cells_) {
+                    c->~linear_cell();
+                }
+            }
+
+            /// @copydoc space::universe::depth
+            std::size_t depth() const override {
+                return depth_;
+            }
+
+            /// @copydoc space::universe::size
+            std::size_t size() const override {
+                return std::size_t(1) << (depth_-1);
+            }
+
+            /// @copydoc space::universe::reach
+            cell<T>& reach(const space::vec_t& spos) override {
+                if (!this->contains(spos)) throw space::exception::invalid_position(spos);
+
+                return reach_(morton_encode(to_internal_(spos)));
+            }
+
+            /// @copydoc space::universe::try_reach
+            const cell<T>* try_reach(const space::vec_t& spos) const override {
+                if (!this->contains(spos)) return nullptr;
+
+                return try_reach_(morton_encode(to_internal_(spos)));
+            }
+
+            /// @copydoc space::universe::for_each_cell
+            void for_each_cell(const ctl::delegate<bool(T&)>& callback) override {
+                for (auto* c : cells_) {
+                    if (!c->empty() && !callback(c->content())) return;
+                }
+            }
+
+            /// @copydoc space::universe::for_each_cell
+            void for_each_cell(const ctl::delegate<bool(const T&)>& callback) const override {
+                for (const auto* c : cells_) {
+                    if (!c->empty() && !callback(c->content())) return;
+                }
+            }
+
+            /// @copydoc space::universe::parallel_for_each_cell
+            /** \note The cells are stored by Morton code, so the cells of a sub-tree are contiguous
+                      in memory. Instead of looking for the exact boundaries of each sub-tree, the
+                      array of cells is split into chunks of equal size: as many as there would
+                      be sub-trees at the requested level.
+            **/
+            void parallel_for_each_cell(const ctl::delegate<void(T&)>& callback,
+                std::size_t split_level) override {
+                const_cast<const linear_universe*>(this)->parallel_for_each_cell(
+                    [&callback](const T& t) { callback(const_cast<T&>(t)); }, split_level
+                );
+            }
+
+            /// @copydoc space::universe::parallel_for_each_cell
+            void parallel_for_each_cell(const ctl::delegate<void(const T&)>& callback,
+                std::size_t split_level) const override {
+                if (cells_.empty()) return;
+
+                std::size_t grain = cells_.size();
+                if (2*split_level < 64) grain >>= 2*split_level;
+                else grain = 0;
+                grain = std::max(grain, std::size_t(1));
+
+                tbb::parallel_for(tbb::blocked_range<std::size_t>(0, cells_.size(), grain),
+                    [this, &callback](const tbb::blocked_range<std::size_t>& r) {
+                        for (std::size_t i = r.begin(); i != r.end(); ++i) {
+                            const linear_cell<T>* c = cells_[i];
+                            if (!c->empty()) callback(c->content());
+                        }
+                    }
+                );
+            }
+
+            /// @copydoc space::universe::bulk_fill
+            std::size_t bulk_fill(
+                std::vector<typename space::universe<T>::positioned_object>& objects) override {
+
+                auto items = sort_batch(objects, *this);
+
+                if (!items.empty()) {
+                    // Merge the sorted batch with the existing cells in a single pass
+                    std::vector<std::uint64_t> keys;
+                    std::vector<linear_cell<T>*> cells;
+                    keys.reserve(keys_.size() + items.size());
+                    cells.reserve(keys_.size() + items.size());
+
+                    std::size_t i = 0;
+                    for (auto& item : items) {
+                        while (i < keys_.size() && keys_[i] < item.key) {
+                            keys.push_back(keys_[i]);
+                            cells.push_back(cells_[i]);
+                            ++i;
+                        }
+
+                        if (!keys.empty() && keys.back() == item.key) {
+                            // Another object of the batch is already there
+                            continue;
+                        }
+
+                        linear_cell<T>* c;
+                        if (i < keys_.size() && keys_[i] == item.key) {
+                            c = cells_[i];
+                            ++i;
+                        } else {
+                            c = new (pool_.allocate()) linear_cell<T>(*this, item.key);
+                        }
+
+                        keys.push_back(item.key);
+                        cells.push_back(c);
+
+                        if (c->empty()) c->fill(std::move(item.obj->second));
+                    }
+
+                    keys.insert(keys.end(), keys_.begin() + i, keys_.end());
+                    cells.insert(cells.end(), cells_.begin() + i, cells_.end());
+
+                    std::swap(keys, keys_);
+                    std::swap(cells, cells_);
+                }
+
+                std::size_t nfail = 0;
+                for (auto& o : objects) {
+                    if (o.second) ++nfail;
+                }
+
+                return nfail;
+            }
+
+            /// @copydoc space::universe::collapse
+            std::size_t collapse() override {
+                std::vector<std::uint64_t> keys = collapse_queue_.pop(collapse_delay_);
+                if (keys.empty()) return 0;
+
+                std::size_t bytes = erase_(keys);
+                reclaimed_bytes_ += bytes;
+                return bytes;
+            }
+
+            /// @copydoc space::universe::set_concurrent_reads
+            /** \note Not supported by this storage: reads are never safe while the cell array
+                      is being modified, since inserting a cell may move all the others.
+            **/
+            void set_concurrent_reads(bool enabled) override {
+                if (enabled) throw space::exception::invalid_storage("concurrent reads");
+            }
+
+            /// @copydoc space::universe::concurrent_reads
+            bool concurrent_reads() const override {
+                return false;
+            }
+
+            /// @copydoc space::universe::set_collapse_delay
+            void set_collapse_delay(std::size_t delay) override {
+                collapse_delay_ = delay;
+            }
+
+            /// @copydoc space::universe::collapse_delay
+            std::size_t collapse_delay() const override {
+                return collapse_delay_;
+            }
+
+            /// @copydoc space::universe::node_count
+            std::size_t node_count() const override {
+                return cells_.size();
+            }
+
+            /// @copydoc space::universe::reclaimed_bytes
+            std::size_t reclaimed_bytes() const override {
+                return reclaimed_bytes_;
+            }
+
+            /// @copydoc space::universe::object_count
+            std::size_t object_count() const override {
+                return object_count_;
+            }
+
+            /// @copydoc space::universe::object_count
+            std::size_t object_count(const space::vec_t& spos, std::size_t level) const override {
+                if (!this->contains(spos)) return 0;
+                vec_t pos = to_internal_(spos);
+
+                // The cells of the region form a contiguous range of Morton codes
+                const std::size_t shift = 2*(depth_ - 1 - std::min(level, depth_ - 1));
+                const std::uint64_t kmin = (morton_encode(pos) >> shift) << shift;
+                const std::uint64_t kmax = kmin + (std::uint64_t(1) << shift);
+                auto first = std::lower_bound(keys_.begin(), keys_.end(), kmin);
+                auto last  = std::lower_bound(first, keys_.end(), kmax);
+
+                std::size_t count = 0;
+                for (auto iter = first; iter != last; ++iter) {
+                    if (!cells_[iter - keys_.begin()]->empty()) ++count;
+                }
+
+                return count;
+            }
+
+            /// @copydoc space::universe::density_map
+            void density_map(std::size_t level, std::vector<std::size_t>& map) const override {
+                level = std::min(level, depth_ - 1);
+                map.assign(std::size_t(1) << 2*level, 0);
+
+                const std::size_t shift = 2*(depth_ - 1 - level);
+                for (std::size_t i = 0; i < cells_.size(); ++i) {
+                    if (cells_[i]->empty()) continue;
+                    vec_t p = morton_decode(keys_[i] >> shift);
+                    ++map[p.x + (std::size_t(p.y) << level)];
+                }
+            }
+
+        protected :
+            /// @copydoc space::universe::memory_usage_
+            void memory_usage_(memory_stats& stats) const override {
+                using pool_type = ctl::slab_pool<linear_cell<T>>;
+                stats.split_cells.clear();
+                stats.unit_cells = keys_.size();
+                stats.occupied_cells = object_count_;
+                stats.structure_bytes += sizeof(*this) +
+                    keys_.size()*sizeof(std::uint64_t) + cells_.size()*sizeof(linear_cell<T>*) +
+                    pool_.size()*pool_type::block_size();
+                stats.reserved_bytes += sizeof(*this) +
+                    keys_.capacity()*sizeof(std::uint64_t) +
+                    cells_.capacity()*sizeof(linear_cell<T>*) +
+                    pool_.capacity()*pool_type::block_size();
+                collapse_queue_.memory_usage(stats);
+            }
+
+            /// @copydoc space::universe::next_cell_in_
+            /** \note The hint is the index of the first stored cell that can be found, i.e. the
+                      one past the last cell that was found.
+            **/
+            const cell<T>* next_cell_in_(const vec_t& pmin, const vec_t& pmax,
+                std::uint64_t& key, std::size_t& hint) const override {
+
+                const std::uint64_t kmin = morton_encode(pmin);
+                const std::uint64_t kmax = morton_encode(pmax);
+
+                // Resume from the hint if it is still where a search for 'key' would start
+                std::size_t i = hint;
+                if (i > keys_.size() || (i > 0 && keys_[i-1] >= key) ||
+                    (i < keys_.size() && keys_[i] < key)) {
+                    i = std::lower_bound(keys_.begin(), keys_.end(), key) - keys_.begin();
+                }
+
+                while (i < keys_.size() && keys_[i] <= kmax) {
+                    vec_t p = morton_decode(keys_[i]);
+                    if (p.x < pmin.x || p.x > pmax.x || p.y < pmin.y || p.y > pmax.y) {
+                        // Left the box: jump straight to the next stored cell that is back in
+                        std::uint64_t next = morton_next_in_box(keys_[i], kmin, kmax);
+                        if (next > kmax) break;
+                        i = std::lower_bound(keys_.begin() + i + 1, keys_.end(), next) -
+                            keys_.begin();
+                        continue;
+                    }
+
+                    if (!cells_[i]->empty()) {
+                        key = keys_[i];
+                        hint = i + 1;
+                        return cells_[i];
+                    }
+
+                    ++i;
+                }
+
+                hint = keys_.size();
+                return nullptr;
+            }
+
+            /// @copydoc space::universe::try_reach_sorted_
+            void try_reach_sorted_(const std::vector<std::uint64_t>& keys,
+                std::vector<const cell<T>*>& cells) const override {
+                cells.resize(keys.size());
+                auto iter = keys_.begin();
+                for (std::size_t i = 0; i < keys.size(); ++i) {
+                    iter = std::lower_bound(iter, keys_.end(), keys[i]);
+                    if (iter != keys_.end() && *iter == keys[i]) {
+                        cells[i] = cells_[iter - keys_.begin()];
+                    } else {
+                        cells[i] = nullptr;
+                    }
+                }
+            }
+
+        private :
+            /// The depth of this universe.
+            const std::size_t depth_;
+
+            /// The sorted Morton codes of all the stored cells.
+            std::vector<std::uint64_t> keys_;
+
+            /// The stored cells, in the same order as keys_.
+            std::vector<linear_cell<T>*> cells_;
+
+            /// The memory pool of the cells.
+            ctl::slab_pool<linear_cell<T>> pool_;
+
+            /// The cells that have been emptied, waiting to be collapsed.
+            collapse_queue collapse_queue_;
+
+            /// See set_collapse_delay().
+            std::size_t collapse_delay_ = space::universe<T>::default_collapse_delay;
+
+            /// See reclaimed_bytes().
+            std::size_t reclaimed_bytes_ = 0;
+
+            /// See object_count().
+            std::size_t object_count_ = 0;
+
+            /// Convert an external position into an internal one.
+            /** \note The position must lie inside this universe (see contains()), else the
+                      conversion can overflow.
+            **/
+            vec_t to_internal_(const space::vec_t& spos) const {
+                const space::pos_t half_size = size()/2;
+                return vec_t(spos + space::vec_t(half_size, half_size));
+            }
+
+            /// Convert an internal position into an external one.
+            space::vec_t to_external_(const vec_t& pos) const {
+                const space::pos_t half_size = size()/2;
+                return space::vec_t(pos) - space::vec_t(half_size, half_size);
+            }
+
+            /// Check that the provided position is valid.
+            /** I.e. it doesn't go past the boundaries of this universe.
+            **/
+            bool check_position_(const vec_t& pos) const {
+                return pos.x < size() && pos.y < size();
+            }
+
+            /// Compute the position of the neighbor of a cell.
+            /** \param key The Morton code of the cell
+                \param dir The direction in which to look for the neighbor
+                \param pos Variable holding the position of the neighbor
+                \return false if the neighbor would lie outside of this universe
+            **/
+            bool get_neighbor_(std::uint64_t key, direction dir, vec_t& pos) const {
+                pos = morton_decode(key);
+                switch (dir) {
+                case direction::left  : if (pos.x == 0) return false; --pos.x; break;
+                case direction::up    : if (pos.y == 0) return false; --pos.y; break;
+                case direction::right : ++pos.x; break;
+                case direction::down  : ++pos.y; break;
+                default : throw space::exception::invalid_direction();
+                }
+
+                return check_position_(pos);
+            }
+
+            /// Find the cell with the provided Morton code, and create it if it does not exist.
+            cell<T>& reach_(std::uint64_t key) {
+                auto iter = std::lower_bound(keys_.begin(), keys_.end(), key);
+                std::size_t i = iter - keys_.begin();
+                if (iter != keys_.end() && *iter == key) {
+                    return *cells_[i];
+                }
+
+                auto* c = new (pool_.allocate()) linear_cell<T>(*this, key);
+                keys_.insert(iter, key);
+                cells_.insert(cells_.begin() + i, c);
+                return *c;
+            }
+
+            /// Find the cell with the provided Morton code, or return nullptr if it does not exist.
+            const cell<T>* try_reach_(std::uint64_t key) const {
+                auto iter = std::lower_bound(keys_.begin(), keys_.end(), key);
+                if (iter != keys_.end() && *iter == key) {
+                    return cells_[iter - keys_.begin()];
+                } else {
+                    return nullptr;
+                }
+            }
+
+            /// Remove the provided cells from the universe if they are empty, and free their memory.
+            /** \param keys The sorted Morton codes of the cells to remove
+                \return The number of bytes given back to the pool
+            **/
+            std::size_t erase_(const std::vector<std::uint64_t>& keys) {
+                std::size_t bytes = 0;
+                std::size_t n = 0;
+                auto kiter = keys.begin();
+                for (std::size_t i = 0; i < keys_.size(); ++i) {
+                    kiter = std::lower_bound(kiter, keys.end(), keys_[i]);
+                    if (kiter != keys.end() && *kiter == keys_[i] && cells_[i]->empty()) {
+                        cells_[i]->~linear_cell();
+                        pool_.deallocate(cells_[i]);
+                        bytes += pool_.block_size();
+                        continue;
+                    }
+
+                    keys_[n] = keys_[i];
+                    cells_[n] = cells_[i];
+                    ++n;
+                }
+
+                keys_.resize(n);
+                cells_.resize(n);
+                return bytes;
+            }
+        };
+    }
+
+    /// Non-virtual handle to navigate the unit cells of a quad-tree universe of depth D.
+    /** A cursor remembers the whole path from the root of the quad-tree to the unit cell it
+        points to, as well as the absolute coordinates of this cell. Compared to using
+        cell::reach() and cell::try_reach(), this has several advantages:
+
+         - no virtual call is involved,
+         - the cursor can point to a cell that does not exist (yet), in which case get()
+           returns nullptr, and move on from there without modifying the structure of space,
+         - reading the coordinates is free,
+         - moving to a neighboring cell only needs to climb the path up to the closest common
+           ancestor of the two cells, which is the direct parent in half of the cases, and is
+           thus O(1) on average.
+
+        The only drawback is that the depth of the universe must be known at compile time. The
+        cursor can be created either from a unit cell, or from a universe and a position.
+
+        \note A cursor is invalidated if the cells on its path are destroyed by anything else
+               than the cursor itself (for example, when clearing a cell triggers a collapse of
+               its parent). In this case, call refresh() before using the cursor again.
+        \note Cursors can only be created for universes with storage::tree.
+    **/
+    template<typename T, std::size_t D>
+    class cursor {
+        template<std::size_t N>
+        using level_t = std::integral_constant<std::size_t, N>;
+
+        /// The universe the cursor is navigating.
+        impl::universe<T,D>* universe_;
+
+        /// The cells on the path, indexed by level (the root is at level 1, index 0 is unused).
+        /** A nullptr means that the path does not exist at this level, nor below.
+        **/
+        void* path_[D+1] = {};
+
+        /// The internal coordinates of the current unit cell.
+        impl::vec_t pos_;
+
+        template<std::size_t N>
+        impl::any_cell<T,N,D>* get_(level_t<N>) const {
+            return static_cast<impl::any_cell<T,N,D>*>(path_[N]);
+        }
+
+        /// Return the id of the sub-cell of the Nth level that leads to the current position.
+        template<std::size_t N>
+        std::size_t get_id_(level_t<N>) const {
+            static const std::size_t shift = D-N-1;
+            return ((pos_.x >> shift) & 1) + 2*((pos_.y >> shift) & 1);
+        }
+
+        /// Rebuild the path below the Nth level.
+        /** \param create Set to true to split the cells that are on the path, if needed.
+        **/
+        template<std::size_t N>
+        void descend_(level_t<N> l, bool create) {
+            auto* c = get_(l);
+            if (c) {
+                if (!c->split && create) c->make_split(*universe_);
+                path_[N+1] = c->split ? &c->split->children[get_id_(l)] : nullptr;
+            } else {
+                path_[N+1] = nullptr;
+            }
+
+            descend_(level_t<N+1>{}, create);
+        }
+
+        void descend_(level_t<D>, bool create) {}
+
+        /// Climb up the path up to the provided level, then rebuild it from there.
+        template<std::size_t N>
+        void ascend_(level_t<N> l, std::size_t level, bool create) {
+            if (N <= level) {
+                descend_(l, create);
+            } else {
+                ascend_(level_t<N-1>{}, level, create);
+            }
+        }
+
+        void ascend_(level_t<1> l, std::size_t level, bool create) {
+            descend_(l, create);
+        }
+
+        /// Fill the path by climbing up the quad-tree from a given cell.
+        template<std::size_t N>
+        void fill_path_(impl::any_cell<T,N,D>& c) {
+            path_[N] = &c;
+            fill_path_(c.parent);
+        }
+
+        void fill_path_(impl::any_cell<T,1,D>& c) {
+            path_[1] = &c;
+            universe_ = &c.parent;
+        }
+
+        /// Update the path after the position has changed.
+        /** \param opos The previous position
+        **/
+        void update_(const impl::vec_t& opos) {
+            // Find the deepest level at which the old and new positions share the same cell
+            impl::pos_t diff = (opos.x ^ pos_.x) | (opos.y ^ pos_.y);
+            if (diff == 0) return;
+
+            std::size_t h = 0;
+            while (diff >>= 1) ++h;
+
+            ascend_(level_t<D>{}, D-h-1, false);
+        }
+
+    public :
+        /// Create a cursor pointing to the provided cell.
+        /** \note Throws space::exception::invalid_cursor if the cell does not belong to a
+                  universe of depth D and storage::tree.
+        **/
+        explicit cursor(cell<T>& c) {
+            auto* lc = dynamic_cast<impl::any_cell<T,D,D>*>(&c);
+            if (!lc) throw space::exception::invalid_cursor(D);
+
+            fill_path_(*lc);
+            pos_ = impl::vec_t(c.get_coordinates() + half_size());
+        }
+
+        /// Create a cursor pointing to the provided position in the provided universe.
+        /** \note Throws space::exception::invalid_cursor if the universe is not of depth D and
+                  storage::tree, and space::exception::invalid_position if the position is
+                  outside of the universe.
+        **/
+        cursor(universe<T>& u, const vec_t& pos) {
+            universe_ = dynamic_cast<impl::universe<T,D>*>(&u);
+            if (!universe_) throw space::exception::invalid_cursor(D);
+
+            // Check before offsetting the position, which could overflow otherwise
+            if (!universe_->contains(pos)) throw space::exception::invalid_position(pos);
+            pos_ = impl::vec_t(pos + half_size());
+
+            path_[1] = &universe_->root_;
+            refresh();
+        }
+
+        /// Return the offset between internal and external coordinates.
+        static vec_t half_size() {
+            static const pos_t half = (pos_t(1) << (D-1))/2;
+            return vec_t(half, half);
+        }
+
+        /// Return the absolute position of the current cell.
+        vec_t get_coordinates() const {
+            return vec_t(pos_) - half_size();
+        }
+
+        /// Return the current cell, or nullptr if it does not exist.
+        cell<T>* get() {
+            return get_(level_t<D>{});
+        }
+
+        /// Return the current cell, or nullptr if it does not exist.
+        const cell<T>* get() const {
+            return get_(level_t<D>{});
+        }
+
+        /// Check if the current cell does not exist or does not contain any object.
+        bool empty() const {
+            const cell<T>* c = get();
+            return !c || c->empty();
+        }
+
+        /// Return the current cell, and create it if it does not exist.
+        /** \note This may split some cells, but does not invalidate the cursor.
+        **/
+        cell<T>& reach() {
+            if (!path_[D]) {
+                std::size_t level = D-1;
+                while (!path_[level]) --level;
+                ascend_(level_t<D>{}, level, true);
+            }
+
+            return *get();
+        }
+
+        /// Move to the neighboring cell in the direction 'dir'.
+        /** \return false if this direction goes past the boundaries of the universe, in which
+                    case the cursor does not move
+            \note This does not modify the structure of space.
+        **/
+        bool move(direction dir) {
+            impl::vec_t opos = pos_;
+            static const impl::pos_t size = impl::pos_t(1) << (D-1);
+
+            switch (dir) {
+            case direction::left  : if (pos_.x == 0)      return false; --pos_.x; break;
+            case direction::up    : if (pos_.y == 0)      return false; --pos_.y; break;
+            case direction::right : if (pos_.x == size-1) return false; ++pos_.x; break;
+            case direction::down  : if (pos_.y == size-1) return false; ++pos_.y; break;
+            default : throw space::exception::invalid_direction();
+            }
+
+            update_(opos);
+            return true;
+        }
+
+        /// Move to the provided absolute position.
+        /** \note Throws space::exception::invalid_position if the position is outside of the
+                  universe, in which case the cursor does not move.
+            \note This does not modify the structure of space.
+        **/
+        void move_to(const vec_t& pos) {
+            // Check before offsetting the position, which could overflow otherwise
+            if (!universe_->contains(pos)) throw space::exception::invalid_position(pos);
+
+            impl::vec_t opos = pos_;
+            pos_ = impl::vec_t(pos + half_size());
+            update_(opos);
+        }
+
+        /// Rebuild the whole path from the root of the quad-tree.
+        /** \note This must be called if the structure of space has changed since the last
+                  time the cursor was used.
+        **/
+        void refresh() {
+            descend_(level_t<1>{}, false);
+        }
+    };
 }
 
-#endif
+#endif
\ No newline at end of file
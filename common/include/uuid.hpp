@@ -4,10 +4,10 @@
 #include <cstdint>
 #include <array>
 #include <iosfwd>
+#include <functional>
 
-namespace sf {
-    class Packet;
-}
+class serialized_packet;
+struct serialized_packet_view;
 
 struct uuid_t {
     std::array<std::uint32_t,4> data_;
@@ -21,8 +21,29 @@ struct uuid_t {
 };
 
 std::ostream& operator << (std::ostream& out, const uuid_t& id);
-sf::Packet& operator << (sf::Packet& out, const uuid_t& id);
-sf::Packet& operator >> (sf::Packet& out, uuid_t& id);
+serialized_packet& operator << (serialized_packet& out, const uuid_t& id);
+serialized_packet& operator >> (serialized_packet& out, uuid_t& id);
+serialized_packet_view& operator >> (serialized_packet_view& in, uuid_t& id);
+
+namespace std {
+    /// Hash function for uuid_t, to use it as a key in unordered containers.
+    template<>
+    struct hash<uuid_t> {
+        std::size_t operator () (const uuid_t& id) const noexcept {
+            // The first half of the uuid is a timestamp and the second half a memory address,
+            // so the low bits of both change a lot, but the high bits rarely do. Mix the two
+            // halves and spread all the bits (finalizer of MurmurHash3).
+            std::uint64_t h = ((std::uint64_t(id.data_[0]) << 32) | id.data_[1]) ^
+                ((std::uint64_t(id.data_[2]) << 32) | id.data_[3])*0x9e3779b97f4a7c15ull;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return std::size_t(h);
+        }
+    };
+}
 
 namespace impl {
     uuid_t make_uuid_(std::uintptr_t obj);
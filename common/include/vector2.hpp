@@ -168,12 +168,17 @@ std::istream& operator >> (std::istream& s, vec2_t<T>& v) {
 }
 
 template<typename T>
-sf::Packet& operator << (sf::Packet& s, const vec2_t<T>& v) {
+serialized_packet& operator << (serialized_packet& s, const vec2_t<T>& v) {
     return s << v.x << v.y;
 }
 
 template<typename T>
-sf::Packet& operator >> (sf::Packet& s, vec2_t<T>& v) {
+serialized_packet& operator >> (serialized_packet& s, vec2_t<T>& v) {
+    return s >> v.x >> v.y;
+}
+
+template<typename T>
+serialized_packet_view& operator >> (serialized_packet_view& s, vec2_t<T>& v) {
     return s >> v.x >> v.y;
 }
 
@@ -1,86 +1,150 @@
 #include "serialized_packet.hpp"
 #include <fstream>
 
-serialized_packet::serialized_packet() :
-    read_pos_(&(this->*rob_impl::stolen<rob_impl::sf_packet_read_pos>::ptr)) {}
+serialized_packet::serialized_packet(const serialized_packet& p) :
+    read_pos_(p.read_pos_), valid_(p.valid_) {
+    append(p.data(), p.size_);
+}
 
-serialized_packet::serialized_packet(const serialized_packet& p) : sf::Packet(p),
-    read_pos_(&(this->*rob_impl::stolen<rob_impl::sf_packet_read_pos>::ptr)) {}
+serialized_packet::serialized_packet(serialized_packet&& p) noexcept :
+    heap_(std::move(p.heap_)), size_(p.size_), capacity_(p.capacity_),
+    read_pos_(p.read_pos_), valid_(p.valid_) {
+    if (!heap_) std::memcpy(inline_, p.inline_, size_);
+    p.reset_();
+}
 
-serialized_packet::serialized_packet(serialized_packet&& p) : sf::Packet(std::move(p)),
-    read_pos_(&(this->*rob_impl::stolen<rob_impl::sf_packet_read_pos>::ptr)) {}
+serialized_packet& serialized_packet::operator = (const serialized_packet& p) {
+    if (this != &p) {
+        clear();
+        append(p.data(), p.size_);
+        read_pos_ = p.read_pos_;
+        valid_ = p.valid_;
+    }
 
-serialized_packet::serialized_packet(const sf::Packet& p) : sf::Packet(p),
-    read_pos_(&(this->*rob_impl::stolen<rob_impl::sf_packet_read_pos>::ptr)) {}
+    return *this;
+}
 
-serialized_packet::serialized_packet(sf::Packet&& p) : sf::Packet(std::move(p)),
-    read_pos_(&(this->*rob_impl::stolen<rob_impl::sf_packet_read_pos>::ptr)) {}
+serialized_packet& serialized_packet::operator = (serialized_packet&& p) noexcept {
+    if (this != &p) {
+        if (p.heap_) {
+            heap_ = std::move(p.heap_);
+            capacity_ = p.capacity_;
+        } else {
+            // The data is stored inline, copying it is cheap and keeps our own buffer
+            std::memcpy(data(), p.inline_, p.size_);
+        }
+
+        size_ = p.size_;
+        read_pos_ = p.read_pos_;
+        valid_ = p.valid_;
+        p.reset_();
+    }
 
-serialized_packet& serialized_packet::operator = (const serialized_packet& p) {
-    sf::Packet::operator=(p);
     return *this;
 }
 
-serialized_packet& serialized_packet::operator = (serialized_packet&& p) {
-    sf::Packet::operator=(std::move(p));
-    return *this;
+void serialized_packet::reset_() {
+    heap_.reset();
+    size_ = 0;
+    capacity_ = inline_capacity;
+    read_pos_ = 0;
+    valid_ = true;
 }
 
-serialized_packet& serialized_packet::operator = (const sf::Packet& p) {
-    sf::Packet::operator=(p);
-    return *this;
+void serialized_packet::reserve(std::size_t capacity) {
+    if (capacity <= capacity_) return;
+
+    std::unique_ptr<char[]> buffer(new char[capacity]);
+    std::memcpy(buffer.get(), data(), size_);
+    heap_ = std::move(buffer);
+    capacity_ = capacity;
 }
 
-serialized_packet& serialized_packet::operator = (sf::Packet&& p) {
-    sf::Packet::operator=(std::move(p));
-    return *this;
+void serialized_packet::resize(std::size_t size) {
+    if (size > size_) {
+        write_(size - size_);
+    } else {
+        size_ = size;
+    }
 }
 
-std::size_t serialized_packet::tellg() const {
-    return *read_pos_;
+void serialized_packet::clear() {
+    size_ = 0;
+    read_pos_ = 0;
+    valid_ = true;
 }
 
-void serialized_packet::seekg(std::size_t pos) {
-    *read_pos_ = pos;
+void serialized_packet::adopt(std::unique_ptr<char[]> buffer, std::size_t size,
+    std::size_t capacity) {
+    heap_ = std::move(buffer);
+    size_ = size;
+    capacity_ = capacity;
+    read_pos_ = 0;
+    valid_ = true;
 }
 
 serialized_packet_view serialized_packet::view() const {
     return serialized_packet_view(*this);
 }
 
-serialized_packet::operator bool() {
-    using btype = bool (sf::Packet::*)(std::size_t);
-    return sf::Packet::operator btype() != nullptr;
+serialized_packet& serialized_packet::operator << (const char* t) {
+    const std::uint32_t s = std::strlen(t);
+    *this << s;
+    append(t, s);
+    return *this;
+}
+
+serialized_packet& serialized_packet::operator << (const std::string& t) {
+    const std::uint32_t s = t.size();
+    *this << s;
+    append(t.data(), s);
+    return *this;
+}
+
+serialized_packet& serialized_packet::operator >> (bool& t) {
+    std::uint8_t b = 0;
+    read_integer_(b);
+    if (valid_) t = b != 0;
+    return *this;
+}
+
+serialized_packet& serialized_packet::operator >> (std::string& t) {
+    std::uint32_t s = 0;
+    read_integer_(s);
+    if (const char* p = read(s)) {
+        t.assign(p, s);
+    }
+
+    return *this;
 }
 
 serialized_packet& operator << (serialized_packet& p, const serialized_packet& ip) {
-    if (ip.endOfPacket()) return p;
+    if (ip.end_of_packet()) return p;
     std::size_t pos = ip.tellg();
-    p.append(static_cast<const char*>(ip.getData()) + pos, ip.getDataSize() - pos);
+    p.append(ip.data() + pos, ip.size() - pos);
     return p;
 }
 
 serialized_packet& operator >> (serialized_packet& p, serialized_packet& op) {
-    if (p.endOfPacket()) return p;
+    if (p.end_of_packet()) return p;
     std::size_t pos = p.tellg();
-    op.append(static_cast<const char*>(p.getData()) + pos, p.getDataSize() - pos);
-    p.seekg(p.getDataSize());
+    op.append(p.data() + pos, p.size() - pos);
+    p.seekg(p.size());
     return p;
 }
 
 std::istream& operator >> (std::istream& in, serialized_packet& p) {
     // Use a temporary packet to deserialize the data size
-    std::uint32_t s;
+    std::uint32_t s = 0;
     serialized_packet tp;
-    std::vector<char> buffer(sizeof(s));
-    in.read(buffer.data(), buffer.size());
-    tp.append(static_cast<const void*>(buffer.data()), buffer.size());
+    tp.resize(sizeof(s));
+    in.read(tp.data(), sizeof(s));
     tp >> s;
 
-    // Then read the actual data
-    buffer.resize(s);
-    in.read(buffer.data(), s);
-    p.append(buffer.data(), s);
+    // Then read the actual data in place
+    const std::size_t pos = p.size();
+    p.resize(pos + s);
+    in.read(p.data() + pos, s);
 
     return in;
 }
@@ -88,23 +152,94 @@ std::istream& operator >> (std::istream& in, serialized_packet& p) {
 std::ostream& operator << (std::ostream& out, const serialized_packet& p) {
     // Use a temporary pack to serialize the data size
     serialized_packet tp;
-    std::uint32_t s = p.getDataSize();
+    std::uint32_t s = p.size();
     tp << s;
-    out.write(static_cast<const char*>(tp.getData()), tp.getDataSize());
+    out.write(tp.data(), tp.size());
 
     // Then write the actual data
-    out.write(static_cast<const char*>(p.getData()), p.getDataSize());
+    out.write(p.data(), p.size());
 
     return out;
 }
 
+serialized_packet_writer::serialized_packet_writer(std::ostream& out, std::size_t chunk_size) :
+    out_(out), chunk_size_(chunk_size) {
+    buffer_.reserve(chunk_size_);
+}
+
+serialized_packet_writer::~serialized_packet_writer() {
+    flush();
+}
+
+void serialized_packet_writer::write(const serialized_packet& p) {
+    write(p.data(), p.size());
+}
+
+void serialized_packet_writer::write(const void* data, std::size_t size) {
+    // Same encoding as serialized_packet for std::uint32_t (big endian)
+    const std::uint32_t s = size;
+    const char prefix[4] = {
+        char((s >> 24) & 0xff), char((s >> 16) & 0xff), char((s >> 8) & 0xff), char(s & 0xff)
+    };
+
+    if (buffer_.size() + sizeof(prefix) + size > chunk_size_) {
+        flush();
+    }
+
+    write_raw(prefix, sizeof(prefix));
+    write_raw(data, size);
+}
+
+void serialized_packet_writer::write_raw(const void* data, std::size_t size) {
+    if (size >= chunk_size_) {
+        // Too large for the buffer, write it directly
+        flush();
+        out_.write(static_cast<const char*>(data), size);
+    } else {
+        if (buffer_.size() + size > chunk_size_) {
+            flush();
+        }
+
+        const char* cdata = static_cast<const char*>(data);
+        buffer_.insert(buffer_.end(), cdata, cdata + size);
+    }
+
+    written_ += size;
+}
+
+void serialized_packet_writer::flush() {
+    if (buffer_.empty()) return;
+    out_.write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+}
+
+std::size_t serialized_packet_writer::bytes_written() const {
+    return written_;
+}
+
+serialized_packet_writer& operator << (serialized_packet_writer& w, const serialized_packet& p) {
+    w.write(p);
+    return w;
+}
+
 serialized_packet_view::serialized_packet_view(const serialized_packet& p) :
-    packet_(&p), read_pos_(p.tellg()) {}
+    data_(p.data()), size_(p.size()), read_pos_(p.tellg()) {}
 
-std::size_t serialized_packet_view::tellg() const {
-    return read_pos_;
+serialized_packet_view::serialized_packet_view(const void* data, std::size_t size) :
+    data_(static_cast<const char*>(data)), size_(size) {}
+
+serialized_packet_view& operator >> (serialized_packet_view& v, bool& t) {
+    std::uint8_t b = 0;
+    if (v >> b) t = b != 0;
+    return v;
 }
 
-void serialized_packet_view::seekg(std::size_t pos) {
-    read_pos_ = pos;
+serialized_packet_view& operator >> (serialized_packet_view& v, std::string& t) {
+    std::uint32_t s = 0;
+    v >> s;
+    if (const char* p = v.read(s)) {
+        t.assign(p, s);
+    }
+
+    return v;
 }
@@ -1,5 +1,7 @@
 #include "space.hpp"
 #include "string.hpp"
+#include <thread>
+#include <functional>
 
 namespace space {
 namespace exception {
@@ -16,9 +18,126 @@ namespace exception {
 
     invalid_position::invalid_position(const vec_t& pos) :
         base("invalid position, goes out of the universe's boundaries: "+string::convert(pos)) {}
+
+    invalid_depth::invalid_depth(std::size_t depth) :
+        base("unsupported universe depth: "+string::convert(depth)) {}
+
+    invalid_cursor::invalid_cursor(std::size_t depth) :
+        base("cannot create a cursor of depth "+string::convert(depth)+
+            ", the cell or universe has a different depth or storage") {}
+
+    invalid_storage::invalid_storage(const std::string& feature) :
+        base("the storage of this universe does not support "+feature) {}
 }
 
 namespace impl {
+    namespace {
+        // Spread the bits of a 32 bit integer to the even bits of a 64 bit integer.
+        std::uint64_t part1by1(std::uint64_t x) {
+            x &= 0x00000000ffffffff;
+            x = (x | (x << 16)) & 0x0000ffff0000ffff;
+            x = (x | (x <<  8)) & 0x00ff00ff00ff00ff;
+            x = (x | (x <<  4)) & 0x0f0f0f0f0f0f0f0f;
+            x = (x | (x <<  2)) & 0x3333333333333333;
+            x = (x | (x <<  1)) & 0x5555555555555555;
+            return x;
+        }
+
+        // Gather the even bits of a 64 bit integer into a 32 bit integer.
+        std::uint64_t compact1by1(std::uint64_t x) {
+            x &= 0x5555555555555555;
+            x = (x | (x >>  1)) & 0x3333333333333333;
+            x = (x | (x >>  2)) & 0x0f0f0f0f0f0f0f0f;
+            x = (x | (x >>  4)) & 0x00ff00ff00ff00ff;
+            x = (x | (x >>  8)) & 0x0000ffff0000ffff;
+            x = (x | (x >> 16)) & 0x00000000ffffffff;
+            return x;
+        }
+    }
+
+    std::uint64_t morton_encode(const vec_t& pos) {
+        return part1by1(pos.x) | (part1by1(pos.y) << 1);
+    }
+
+    vec_t morton_decode(std::uint64_t code) {
+        return vec_t(compact1by1(code), compact1by1(code >> 1));
+    }
+
+    std::uint64_t morton_next_in_box(std::uint64_t code, std::uint64_t kmin, std::uint64_t kmax) {
+        // This is the BIGMIN algorithm of Tropf & Herzog (1981). Going from the highest bit,
+        // the box [kmin,kmax] is split in two halves along the dimension of the current bit,
+        // until 'code' is found to lie before or after the remaining part of the box.
+        std::uint64_t next = std::uint64_t(-1);
+        for (std::size_t b = 64; b-- > 0;) {
+            const std::uint64_t bit = std::uint64_t(1) << b;
+            const std::uint64_t lower = (b%2 == 0 ? 0x5555555555555555 : 0xaaaaaaaaaaaaaaaa) &
+                (bit - 1);
+
+            const bool c = code & bit, mn = kmin & bit, mx = kmax & bit;
+            if (mn == mx) {
+                // The box lies on one side of the split
+                if (c != mn) return c ? next : kmin;
+            } else if (c) {
+                // 'code' lies in the upper half: look for the next code there
+                kmin = (kmin & ~lower) | bit;
+            } else {
+                // 'code' lies in the lower half: the upper half is the fallback
+                next = (kmin & ~lower) | bit;
+                kmax = (kmax & ~bit) | lower;
+            }
+        }
+
+        // 'code' lies inside the box
+        return code;
+    }
+
+    std::size_t epoch_manager::enter() {
+        // Start looking from a different slot for each thread, to limit contention
+        const std::size_t first = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+        while (true) {
+            const std::uint64_t e = epoch_.load();
+            for (std::size_t i = 0; i < max_readers; ++i) {
+                slot& sl = slots_[(first + i) % max_readers];
+                std::uint64_t expected = 0;
+                if (sl.epoch.load(std::memory_order_relaxed) == 0 &&
+                    sl.epoch.compare_exchange_strong(expected, e)) {
+                    // Make sure that either the writer sees this reader in safe_epoch(),
+                    // or this reader sees all the memory that has been retired so far
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    return (first + i) % max_readers;
+                }
+            }
+
+            std::this_thread::yield();
+        }
+    }
+
+    void epoch_manager::leave(std::size_t slot) {
+        slots_[slot].epoch.store(0, std::memory_order_release);
+    }
+
+    std::uint64_t epoch_manager::epoch() const {
+        return epoch_.load(std::memory_order_relaxed);
+    }
+
+    void epoch_manager::advance() {
+        epoch_.fetch_add(1);
+    }
+
+    std::uint64_t epoch_manager::safe_epoch() const {
+        // Pairs with the fence in enter()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        std::uint64_t e = epoch_.load();
+        for (const slot& sl : slots_) {
+            std::uint64_t se = sl.epoch.load(std::memory_order_acquire);
+            if (se != 0 && se < e) e = se;
+        }
+
+        return e;
+    }
+
     bool get_cell_id(std::size_t id, direction dir, std::size_t& next_id) {
         switch (id) {
         case sub_cell::TL :
@@ -1,6 +1,6 @@
 #include "uuid.hpp"
 #include "range.hpp"
-#include <SFML/Network/Packet.hpp>
+#include "serialized_packet.hpp"
 #include <iostream>
 #include <chrono>
 
@@ -68,7 +68,7 @@ std::ostream& operator << (std::ostream& out, const uuid_t& id) {
     return out;
 }
 
-sf::Packet& operator << (sf::Packet& out, const uuid_t& id) {
+serialized_packet& operator << (serialized_packet& out, const uuid_t& id) {
     for (std::size_t i : range(id.data_)) {
         out << id.data_[i];
     }
@@ -76,7 +76,15 @@ sf::Packet& operator << (sf::Packet& out, const uuid_t& id) {
     return out;
 }
 
-sf::Packet& operator >> (sf::Packet& in, uuid_t& id) {
+serialized_packet& operator >> (serialized_packet& in, uuid_t& id) {
+    for (std::size_t i : range(id.data_)) {
+        in >> id.data_[i];
+    }
+
+    return in;
+}
+
+serialized_packet_view& operator >> (serialized_packet_view& in, uuid_t& id) {
     for (std::size_t i : range(id.data_)) {
         in >> id.data_[i];
     }
@@ -3,6 +3,7 @@
 
 #include <netcom_base.hpp>
 #include <SFML/Network.hpp>
+#include <packet_socket.hpp>
 #include <scoped_connection_pool.hpp>
 #include <unique_id_provider.hpp>
 #include <shared_collection.hpp>
@@ -91,6 +92,7 @@ namespace server {
 
             std::unique_ptr<sf::TcpSocket> socket;
             actor_id_t                     id;
+            packet_receiver                receiver;
         };
 
         using connected_client_list_t = ctl::sorted_vector<connected_client_t, mem_var_comp(&connected_client_t::id)>;
@@ -6,6 +6,7 @@
 namespace server {
     class serializable {
         std::string name_;
+        bool compression_ = false;
 
     public :
         serializable(std::string name);
@@ -14,10 +15,27 @@ namespace server {
         // Simple localizable name describing the serializable data
         const std::string& name() const;
 
+        // Compress the data written by serialize() (see block_compression)
+        void set_compression(bool compress);
+        bool compression() const;
+
         // Store current game state into cached serializable structs
         virtual void save_data() = 0;
         // Serialize the serializable structs on disk
         virtual void serialize(const std::string& dir) const = 0;
+        // Serialize on disk only what changed since the previous save, which was written in
+        // 'base_dir'. The default implementation writes a full save.
+        virtual void serialize_delta(const std::string& dir, const std::string& base_dir) const {
+            serialize(dir);
+        }
+        // Fold a differential save and all its bases into a full save, in place. This must not
+        // modify the data cached by save_data(), since it can run while a save is in progress.
+        virtual void compact(const std::string& dir) {}
+        // Directory of the save that the differential save in 'dir' is based on, or an empty
+        // string if 'dir' holds a full save
+        virtual std::string base_directory(const std::string& dir) const {
+            return "";
+        }
 
         // De-serizalize saved content into serializable structs
         virtual void deserialize(const std::string& dir) = 0;
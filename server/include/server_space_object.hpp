@@ -4,19 +4,25 @@
 #include <space.hpp>
 #include <uuid.hpp>
 #include <std_addon.hpp>
+#include <unordered_map>
 
 namespace server {
     class space_object;
+    class space_object_index;
+    class space_object_factory;
 
     using space_cell = space::cell<server::space_object>;
 
     class space_object {
+        friend class space_object_factory;
+
         const uuid_t id_;
-        space_cell* cell_;
+        space_cell* cell_ = nullptr;
+        space_object_index* index_ = nullptr;
 
     public :
         explicit space_object(uuid_t);
-        virtual ~space_object() = default;
+        virtual ~space_object();
 
         virtual void serialize(serialized_packet& p) const = 0;
         virtual void deserialize(serialized_packet& p) = 0;
@@ -24,9 +30,46 @@ namespace server {
         uuid_t id() const;
         virtual std::uint16_t type() const = 0;
 
+        /// Return the number of bytes used by this object, including the memory it owns.
+        /** \note The default implementation only returns the size of this base class, so
+                  derived classes should override it.
+        **/
+        virtual std::size_t memory_size() const;
+
         space_cell* cell();
         const space_cell* cell() const;
         void notify_parent_cell(space_cell* c);
+
+        /// Signal that the state of this object changed, so that it is saved again.
+        /** Saves only serialize again the objects that changed since the previous save, the
+            others are written from the data of that save. An object is marked as changed
+            automatically when it is placed in or moved to a cell, and each time it is looked
+            up with the non-const universe::find_object(), since it can then be modified.
+            Call this function after modifying an object through a pointer that was kept
+            since an earlier save, or from within the object itself.
+            \note This does nothing if the object is not placed in a cell.
+        **/
+        void touch();
+    };
+
+    /// Index of the space objects that are placed in a universe, by id.
+    /** Objects created by a space_object_factory that uses this index are automatically
+        inserted in the index when they are placed in a cell, and removed when they are
+        taken out of their cell or destroyed. Moving an object from one cell to another
+        does not modify the index.
+    **/
+    class space_object_index {
+        std::unordered_map<uuid_t, space_object*> objects_;
+
+    public :
+        void insert(space_object& obj);
+        void erase(const space_object& obj);
+
+        /// Find the object with the provided id, or nullptr if it is not placed in space.
+        space_object* find(uuid_t id);
+        const space_object* find(uuid_t id) const;
+
+        std::size_t size() const;
     };
 
     class space_object_factory {
@@ -51,7 +94,7 @@ namespace server {
 
                 // Construct object
                 try {
-                    obj = new (buffer) T(id);
+                    obj.reset(new (buffer) T(id));
                 } catch (...) {
                     operator delete(buffer);
                 }
@@ -79,7 +122,10 @@ namespace server {
 
         ctl::sorted_vector<std::unique_ptr<object_factory>, factory_cmp> factories_;
 
+        space_object_index* index_;
+
     public :
+        explicit space_object_factory(space_object_index* index = nullptr);
 
         template<typename T>
         void add_factory(std::uint16_t type) {
@@ -19,10 +19,23 @@ namespace state {
 
         ctl::ptr_vector<server::serializable> save_chunks_;
 
+        /// Directories of the last full save, and of the differential saves built on top of it.
+        std::vector<std::string> save_chain_;
+        bool differential_saves_ = false;
+        std::size_t max_delta_chain_ = 8;
+
         std::unique_ptr<server::player_list> plist_;
 
         server::universe universe_;
 
+        /// Fold all the saves that are based on 'dir' into full saves.
+        /** \param dir   The directory of the save
+            \param chain The directories of the current chain of saves, see save_chain_
+            \note This runs in the thread of the save in progress.
+        **/
+        void compact_dependent_saves_(const std::string& dir,
+            const std::vector<std::string>& chain);
+
     public :
         explicit game(server::instance& serv);
 
@@ -30,8 +43,24 @@ namespace state {
 
         void set_player_list(std::unique_ptr<server::player_list> plist);
 
+        void log_memory_usage(const space::memory_stats& stats);
+
+        /// Save the game in the provided directory.
+        /** If differential saves are enabled (config: "save.differential"), this only writes
+            what changed since the previous save, and the previous save becomes the base of
+            this one. A full save is written instead after "save.max_delta_chain" differential
+            saves, or if 'dir' is already part of the current chain.
+            Differential saves that are based on 'dir' (in the current chain, or stored next to
+            'dir') are compacted before 'dir' is overwritten, so they remain loadable. This is
+            done in the background along with writing the save, after the game is unblocked. If
+            it fails, 'dir' is left untouched and the save fails (see game_save_progress).
+            \note The base of a differential save must not be deleted, unless the differential
+                  save is compacted first (see compact_directory()).
+        **/
         void save_to_directory(const std::string& dir);
         void load_from_directory(const std::string& dir);
+        /// Fold a differential save and its bases into a full save.
+        void compact_directory(const std::string& dir);
         bool is_saved_game_directory(const std::string& dir) const;
     };
 }
@@ -70,6 +99,37 @@ namespace server {
             std::string details;
         };
     };
+
+    NETCOM_PACKET(game_compact_save) {
+        NETCOM_REQUIRES("game_configurer");
+
+        std::string save;
+
+        struct answer {};
+        struct failure {
+            enum class reason {
+                cannot_compact_while_saving,
+                no_such_saved_game,
+                invalid_saved_game
+            } rsn;
+
+            std::string details;
+        };
+    };
+
+    NETCOM_PACKET(universe_memory) {
+        NETCOM_REQUIRES("admin");
+
+        struct answer {
+            std::vector<std::uint64_t> split_cells;
+            std::uint64_t unit_cells;
+            std::uint64_t occupied_cells;
+            std::uint64_t structure_bytes;
+            std::uint64_t reserved_bytes;
+            std::uint64_t object_bytes;
+        };
+        struct failure {};
+    };
 }
 }
 
@@ -79,7 +139,8 @@ namespace server {
         enum class step {
             gathering_game_data,
             saving_to_disk,
-            game_saved
+            game_saved,
+            save_failed
         } stp;
     };
 
@@ -4,37 +4,70 @@
 #include <string>
 #include <memory>
 #include <space.hpp>
+#include <uuid.hpp>
 #include "server_serializable.hpp"
 
 namespace server {
     class universe_serializer;
     class space_object;
     class space_object_factory;
+    class space_object_index;
 
     using space_universe = space::universe<server::space_object>;
 
     class universe {
         friend class universe_serializer;
 
+        // NB: the index must outlive the objects, hence it is declared first
+        std::unique_ptr<space_object_index>   index_;
         std::unique_ptr<space_universe>       space_;
         std::unique_ptr<space_object_factory> object_factory_;
 
     public :
+        /// Minimum depth of the universe, see create_space().
+        static constexpr std::size_t min_depth = 2;
+        /// Maximum depth of the universe, see create_space().
+        static constexpr std::size_t max_depth = space::max_linear_depth;
+
         universe();
 
         bool create_space(std::size_t size);
 
         virtual ~universe();
 
+        /// Measure the memory used by the universe, see space::universe::memory_usage().
+        /** \note If no space has been created yet, all the statistics are zero.
+        **/
+        space::memory_stats memory_usage() const;
+
+        /// Find the object with the provided id among the objects placed in the universe.
+        /** \return The object, or nullptr if there is none. Its cell and position can be
+                    obtained through space_object::cell().
+            \note This is O(1), and only works for the objects created by the object factory of
+                  this universe.
+            \note Since the object can be modified through the returned pointer, it is marked as
+                  changed, and will be serialized again by the next save (see
+                  space_object::touch()). Use the const overload to only read the object.
+        **/
+        space_object* find_object(uuid_t id);
+        const space_object* find_object(uuid_t id) const;
+
+        /// Return the factory that creates the objects of this universe.
+        /** \note The types of objects must be registered there before loading a saved game.
+        **/
+        space_object_factory& object_factory();
+
         std::unique_ptr<universe_serializer> make_serializer();
     };
 
     struct universe_serializer_internal_buffer;
+    struct universe_serializer_cache;
 
     class universe_serializer : public server::serializable {
         universe& universe_;
 
         std::unique_ptr<universe_serializer_internal_buffer> buffer_;
+        std::unique_ptr<universe_serializer_cache>           cache_;
 
     public :
         explicit universe_serializer(universe& uni);
@@ -42,6 +75,9 @@ namespace server {
 
         void save_data() override;
         void serialize(const std::string& dir) const override;
+        void serialize_delta(const std::string& dir, const std::string& base_dir) const override;
+        void compact(const std::string& dir) override;
+        std::string base_directory(const std::string& dir) const override;
 
         void deserialize(const std::string& dir) override;
         void load_data_first_pass() override;
@@ -225,7 +225,7 @@ namespace server {
                             out_packet_t p = create_message(
                                 make_packet<message::server::connection_granted>(id)
                             );
-                            s->send(p.impl);
+                            send_packet(*s, p.impl);
 
                             selector_.add(*s);
                             connected_clients_.insert(connected_client_t(std::move(s), id));
@@ -235,7 +235,7 @@ namespace server {
                                     message::server::connection_denied::reason::too_many_clients
                                 )
                             );
-                            s->send(p.impl);
+                            send_packet(*s, p.impl);
                         }
                     } else {
                         out_packet_t p = create_message(
@@ -243,7 +243,7 @@ namespace server {
                                 message::server::connection_denied::reason::too_many_clients
                             )
                         );
-                        s->send(p.impl);
+                        send_packet(*s, p.impl);
                     }
                 }
             }
@@ -254,14 +254,11 @@ namespace server {
             for (auto& c : connected_clients_) {
                 auto& s = c.socket;
                 if (selector_.isReady(*s)) {
-                    sf::Packet p;
-                    switch (s->receive(p)) {
-                    case sf::Socket::Done : {
-                        in_packet_t ip(c.id);
-                        ip.impl = std::move(p);
+                    in_packet_t ip(c.id);
+                    switch (c.receiver.receive(*s, ip.impl)) {
+                    case sf::Socket::Done :
                         input_.push(std::move(ip));
                         break;
-                    }
                     case sf::Socket::Disconnected :
                     case sf::Socket::Error :
                         remove_list.push_back(c.id);
@@ -279,7 +276,7 @@ namespace server {
                     // Send to all clients
                     for (auto& c : connected_clients_) {
                         auto& s = c.socket;
-                        switch (s->send(op.impl)) {
+                        switch (send_packet(*s, op.impl)) {
                         case sf::Socket::Done : break;
                         case sf::Socket::Disconnected :
                         case sf::Socket::Error :
@@ -308,7 +305,7 @@ namespace server {
                     };
 
                     auto& s = iter->socket;
-                    switch (s->send(op.impl)) {
+                    switch (send_packet(*s, op.impl)) {
                     case sf::Socket::Done : break;
                     case sf::Socket::Disconnected :
                     case sf::Socket::Error :
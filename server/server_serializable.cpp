@@ -6,4 +6,12 @@ namespace server {
     const std::string& serializable::name() const {
         return name_;
     }
+
+    void serializable::set_compression(bool compress) {
+        compression_ = compress;
+    }
+
+    bool serializable::compression() const {
+        return compression_;
+    }
 }
@@ -3,10 +3,22 @@
 namespace server {
     space_object::space_object(uuid_t id) : id_(id) {}
 
+    space_object::~space_object() {
+        if (index_ && cell_) index_->erase(*this);
+    }
+
     uuid_t space_object::id() const {
         return id_;
     }
 
+    std::size_t space_object::memory_size() const {
+        return sizeof(space_object);
+    }
+
+    void space_object::touch() {
+        if (cell_) cell_->touch();
+    }
+
     space_cell* space_object::cell() {
         return cell_;
     }
@@ -16,20 +28,63 @@ namespace server {
     }
 
     void space_object::notify_parent_cell(space::cell<space_object>* c) {
+        if (index_) {
+            if (c && !cell_) {
+                index_->insert(*this);
+            } else if (!c && cell_) {
+                index_->erase(*this);
+            }
+        }
+
         cell_ = c;
     }
 
+    void space_object_index::insert(space_object& obj) {
+        objects_[obj.id()] = &obj;
+    }
+
+    void space_object_index::erase(const space_object& obj) {
+        auto iter = objects_.find(obj.id());
+        if (iter != objects_.end() && iter->second == &obj) {
+            objects_.erase(iter);
+        }
+    }
+
+    space_object* space_object_index::find(uuid_t id) {
+        auto iter = objects_.find(id);
+        if (iter == objects_.end()) return nullptr;
+
+        return iter->second;
+    }
+
+    const space_object* space_object_index::find(uuid_t id) const {
+        auto iter = objects_.find(id);
+        if (iter == objects_.end()) return nullptr;
+
+        return iter->second;
+    }
+
+    std::size_t space_object_index::size() const {
+        return objects_.size();
+    }
+
+    space_object_factory::space_object_factory(space_object_index* index) : index_(index) {}
+
     std::unique_ptr<space_object> space_object_factory::make(std::uint16_t type) const {
         auto iter = factories_.find(type);
         if (iter == factories_.end()) return nullptr;
 
-        return (*iter)->make();
+        std::unique_ptr<space_object> obj = (*iter)->make();
+        if (obj) obj->index_ = index_;
+        return obj;
     }
 
     std::unique_ptr<space_object> space_object_factory::make(std::uint16_t type, uuid_t id) const {
         auto iter = factories_.find(type);
         if (iter == factories_.end()) return nullptr;
 
-        return (*iter)->make(id);
+        std::unique_ptr<space_object> obj = (*iter)->make(id);
+        if (obj) obj->index_ = index_;
+        return obj;
     }
 }
@@ -2,12 +2,24 @@
 #include "server_state_idle.hpp"
 #include "server_instance.hpp"
 #include <filesystem.hpp>
+#include <config.hpp>
+#include <string.hpp>
+#include <algorithm>
 
 namespace server {
 namespace state {
     game::game(server::instance& serv) : base(serv, server::state_id::game, "game"), saving_(false) {
         // TODO: add all game components to this container
         save_chunks_.push_back(universe_.make_serializer());
+
+        pool_ << serv_.get_conf().bind("save.compression", [this](bool compress) {
+            for (auto& c : save_chunks_) {
+                c.set_compression(compress);
+            }
+        });
+
+        pool_ << serv_.get_conf().bind("save.differential", differential_saves_)
+              << serv_.get_conf().bind("save.max_delta_chain", max_delta_chain_);
     }
 
     void game::register_callbacks() {
@@ -57,6 +69,42 @@ namespace state {
             }
         });
 
+        pool_ << net_.watch_request(
+            [this](server::netcom::request_t<request::server::game_compact_save>&& req) {
+            try {
+                compact_directory(req.arg.save);
+                req.answer();
+            } catch (request::server::game_compact_save::failure& fail) {
+                for (auto& c : save_chunks_) {
+                    c.clear();
+                }
+
+                req.fail(std::move(fail));
+            } catch (...) {
+                for (auto& c : save_chunks_) {
+                    c.clear();
+                }
+
+                out_.error("unexpected exception in game::compact_directory()");
+                throw;
+            }
+        });
+
+        pool_ << net_.watch_request(
+            [this](server::netcom::request_t<request::server::universe_memory>&& req) {
+            auto stats = universe_.memory_usage();
+            log_memory_usage(stats);
+
+            request::server::universe_memory::answer ans;
+            ans.split_cells.assign(stats.split_cells.begin(), stats.split_cells.end());
+            ans.unit_cells = stats.unit_cells;
+            ans.occupied_cells = stats.occupied_cells;
+            ans.structure_bytes = stats.structure_bytes;
+            ans.reserved_bytes = stats.reserved_bytes;
+            ans.object_bytes = stats.object_bytes;
+            req.answer(std::move(ans));
+        });
+
         pool_ << net_.watch_request(
             [this](server::netcom::request_t<request::server::stop_and_idle>&& req) {
             serv_.set_state<server::state::idle>();
@@ -68,6 +116,22 @@ namespace state {
         plist_ = std::move(plist);
     }
 
+    void game::log_memory_usage(const space::memory_stats& stats) {
+        std::string split;
+        for (std::size_t n : stats.split_cells) {
+            if (!split.empty()) split += ", ";
+            split += string::convert(n);
+        }
+
+        out_.note("universe memory: ", stats.occupied_cells, "/", stats.unit_cells,
+            " occupied cells, ", stats.structure_bytes, " bytes used (",
+            stats.reserved_bytes, " reserved) by space, ", stats.object_bytes,
+            " bytes used by objects");
+        if (!split.empty()) {
+            out_.note("universe memory: split cells per level: ", split);
+        }
+    }
+
     void game::save_to_directory(const std::string& dir) {
         using failure = request::server::game_save::failure;
 
@@ -77,6 +141,26 @@ namespace state {
 
         saving_ = true;
 
+        // The previous save is over, but its thread may not have terminated yet
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+
+        // The saves that may depend on 'dir', see compact_dependent_saves_()
+        std::vector<std::string> chain = save_chain_;
+
+        // Only save what changed since the previous save, if possible
+        std::string base_dir;
+        if (differential_saves_ && !save_chain_.empty() &&
+            save_chain_.size() <= max_delta_chain_ &&
+            std::find(save_chain_.begin(), save_chain_.end(), dir) == save_chain_.end() &&
+            file::exists(save_chain_.back())) {
+            base_dir = save_chain_.back();
+            save_chain_.push_back(dir);
+        } else {
+            save_chain_ = {dir};
+        }
+
         // Block the game and bake all game data into serializable structures
         net_.send_message(netcom::all_actor_id, make_packet<message::server::game_save_progress>(
             message::server::game_save_progress::step::gathering_game_data
@@ -91,9 +175,33 @@ namespace state {
             message::server::game_save_progress::step::saving_to_disk
         ));
 
-        thread_ = std::thread([this, dir]() {
-            for (auto& c : save_chunks_) {
-                c.serialize(dir);
+        thread_ = std::thread([this, dir, base_dir, chain]() {
+            auto step = message::server::game_save_progress::step::game_saved;
+
+            try {
+                // Never overwrite the base of a differential save: fold the saves that depend
+                // on 'dir' into full saves first. This reads and writes whole saves, so it is
+                // done here rather than while the game is blocked.
+                compact_dependent_saves_(dir, chain);
+
+                for (auto& c : save_chunks_) {
+                    if (base_dir.empty()) {
+                        c.serialize(dir);
+                    } else {
+                        c.serialize_delta(dir, base_dir);
+                    }
+                }
+            } catch (request::server::game_load::failure& fail) {
+                out_.error("could not compact a save based on '", dir, "': ", fail.details);
+                step = message::server::game_save_progress::step::save_failed;
+            } catch (std::exception& e) {
+                out_.error("could not save the game in '", dir, "': ", e.what());
+                step = message::server::game_save_progress::step::save_failed;
+            }
+
+            // The next save cannot be based on this one if it failed
+            if (step == message::server::game_save_progress::step::save_failed) {
+                save_chain_.clear();
             }
 
             // Clear buffers
@@ -101,9 +209,8 @@ namespace state {
                 c.clear();
             }
 
-            net_.send_message(netcom::all_actor_id, make_packet<message::server::game_save_progress>(
-                message::server::game_save_progress::step::game_saved
-            ));
+            net_.send_message(netcom::all_actor_id,
+                make_packet<message::server::game_save_progress>(step));
 
             saving_ = false;
         });
@@ -128,6 +235,9 @@ namespace state {
 
         // NOTE: One might need to clear the game state before
 
+        // The next save cannot be based on a save made before loading
+        save_chain_.clear();
+
         std::uint16_t s = 0;
         std::uint16_t nchunk = save_chunks_.size();
         for (auto& c : save_chunks_) {
@@ -154,6 +264,62 @@ namespace state {
         for (auto& c : save_chunks_) {
             c.clear();
         }
+
+        log_memory_usage(universe_.memory_usage());
+    }
+
+    void game::compact_directory(const std::string& dir) {
+        using failure = request::server::game_compact_save::failure;
+
+        if (saving_) {
+            throw failure{failure::reason::cannot_compact_while_saving, ""};
+        }
+
+        if (!file::exists(dir)) {
+            throw failure{failure::reason::no_such_saved_game, ""};
+        }
+
+        if (!is_saved_game_directory(dir)) {
+            throw failure{failure::reason::invalid_saved_game, ""};
+        }
+
+        try {
+            for (auto& c : save_chunks_) {
+                c.compact(dir);
+                c.clear();
+            }
+        } catch (request::server::game_load::failure& fail) {
+            throw failure{failure::reason::invalid_saved_game, fail.details};
+        }
+    }
+
+    void game::compact_dependent_saves_(const std::string& dir,
+        const std::vector<std::string>& chain) {
+        // Look for dependent saves in the chain, and next to 'dir' where other saves are
+        // stored
+        std::vector<std::string> candidates = chain;
+        const std::string parent = file::get_directory(dir);
+        for (auto& d : file::list_directories(parent)) {
+            candidates.push_back(parent+d+"/");
+        }
+
+        for (auto& d : candidates) {
+            if (d == dir) continue;
+
+            bool dependent = false;
+            for (auto& c : save_chunks_) {
+                if (c.base_directory(d) == dir) {
+                    dependent = true;
+                    break;
+                }
+            }
+
+            if (!dependent) continue;
+
+            for (auto& c : save_chunks_) {
+                c.compact(d);
+            }
+        }
     }
 
     bool game::is_saved_game_directory(const std::string& dir) const {
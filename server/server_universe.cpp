@@ -5,43 +5,359 @@
 #include <std_addon.hpp>
 #include <string.hpp>
 #include <filesystem.hpp>
+#include <block_compression.hpp>
+#include <crc32.hpp>
 #include <fstream>
+#include <algorithm>
+#include <iterator>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <atomic>
 
 namespace server {
-    universe::universe() : object_factory_(std::make_unique<space_object_factory>()) {
+    universe::universe() : index_(std::make_unique<space_object_index>()),
+        object_factory_(std::make_unique<space_object_factory>(index_.get())) {
         // Add object factories?
     }
 
     universe::~universe() {}
 
     bool universe::create_space(std::size_t size) {
-        // Ugly but...
-        switch (size) {
-            case  0 : return true;
-            case  2 : space_ = space_universe::make< 2>(); return true;
-            case  3 : space_ = space_universe::make< 3>(); return true;
-            case  4 : space_ = space_universe::make< 4>(); return true;
-            case  5 : space_ = space_universe::make< 5>(); return true;
-            case  6 : space_ = space_universe::make< 6>(); return true;
-            case  7 : space_ = space_universe::make< 7>(); return true;
-            case  8 : space_ = space_universe::make< 8>(); return true;
-            case  9 : space_ = space_universe::make< 9>(); return true;
-            case 10 : space_ = space_universe::make<10>(); return true;
-            case 11 : space_ = space_universe::make<11>(); return true;
-            case 12 : space_ = space_universe::make<12>(); return true;
-            case 13 : space_ = space_universe::make<13>(); return true;
-            case 14 : space_ = space_universe::make<14>(); return true;
-            case 15 : space_ = space_universe::make<15>(); return true;
-            case 16 : space_ = space_universe::make<16>(); return true;
-            default : return false;
-        }
+        if (size == 0) return true;
+        if (size < min_depth || size > max_depth) return false;
+
+        space_ = space_universe::make(size);
+        return true;
+    }
+
+    space::memory_stats universe::memory_usage() const {
+        if (!space_) return space::memory_stats{};
+
+        return space_->memory_usage([](const space_object& obj) {
+            return obj.memory_size();
+        });
+    }
+
+    space_object* universe::find_object(uuid_t id) {
+        // The object can be modified through the returned pointer, so it must be saved again
+        space_object* obj = index_->find(id);
+        if (obj) obj->touch();
+        return obj;
+    }
+
+    const space_object* universe::find_object(uuid_t id) const {
+        return index_->find(id);
+    }
+
+    space_object_factory& universe::object_factory() {
+        return *object_factory_;
     }
 
     /// Serialization
 
     static const std::string master_file_name = "universe.csf";
+    /// Present in differential saves only, contains the directory of the base save.
+    static const std::string base_file_name = "universe.base";
+    /// Maximum number of differential saves on top of a full save, to detect cycles.
+    static const std::size_t max_chain_length = 1024;
+
+    static bool position_less(const space::vec_t& p1, const space::vec_t& p2) {
+        return p1.y < p2.y || (p1.y == p2.y && p1.x < p2.x);
+    }
+
+    namespace v2 {
+        // Little endian encoding of the header and index
+        template<typename T>
+        static void put_le(char* out, T v) {
+            using U = typename std::make_unsigned<T>::type;
+            U u = static_cast<U>(v);
+            for (std::size_t i = 0; i < sizeof(T); ++i) {
+                out[i] = char((u >> (8*i)) & 0xff);
+            }
+        }
 
-    struct universe_serializer_internal_buffer : v1::universe_serializer_internal_buffer {};
+        template<typename T>
+        static T get_le(const char* in) {
+            using U = typename std::make_unsigned<T>::type;
+            U u = 0;
+            for (std::size_t i = 0; i < sizeof(T); ++i) {
+                u |= U(static_cast<unsigned char>(in[i])) << (8*i);
+            }
+
+            return static_cast<T>(u);
+        }
+
+        void write_header(char* out, const universe_header& header) {
+            std::copy(std::begin(version_header), std::end(version_header), out);
+            put_le(out+8,  header.depth);
+            put_le(out+10, header.entry_size);
+            put_le(out+12, header.nobject);
+            put_le(out+16, header.index_offset);
+            put_le(out+24, header.records_offset);
+            put_le(out+32, header.records_size);
+        }
+
+        void write_entry(char* out, const object_entry& entry) {
+            for (std::size_t i = 0; i < 4; ++i) {
+                put_le(out+4*i, entry.id.data_[i]);
+            }
+
+            put_le(out+16, entry.position.x);
+            put_le(out+20, entry.position.y);
+            put_le(out+24, entry.type);
+            put_le(out+26, std::uint16_t(0));
+            put_le(out+28, entry.size);
+            put_le(out+32, entry.offset);
+        }
+
+        universe_file::exception::exception(const std::string& msg) : std::runtime_error(msg) {}
+
+        universe_file::universe_file(const std::string& filename) :
+            universe_file(mapped_file(filename)) {}
+
+        universe_file::universe_file(mapped_file f) : file_(std::move(f)) {
+            if (!file_.open()) {
+                throw exception("could not open save file");
+            }
+
+            if (block_compression::is_compressed(file_.data(), file_.size())) {
+                try {
+                    decompressed_ = block_compression::decompress(file_.data(), file_.size());
+                } catch (block_compression::exception& e) {
+                    throw exception(e.what());
+                }
+
+                // The mapping is not needed anymore
+                file_ = mapped_file();
+                data_ = decompressed_.data();
+                size_ = decompressed_.size();
+            } else {
+                data_ = file_.data();
+                size_ = file_.size();
+            }
+
+            check_();
+        }
+
+        universe_file::universe_file(std::vector<char> content) :
+            decompressed_(std::move(content)) {
+            data_ = decompressed_.data();
+            size_ = decompressed_.size();
+            check_();
+        }
+
+        void universe_file::check_() {
+            if (!is_v2(data_, size_)) {
+                throw exception("unsupported save file version");
+            }
+
+            if (size_ < universe_header::size) {
+                throw exception("save file is too small");
+            }
+
+            // Checksums, if any, are not part of the content
+            std::uint64_t size = size_;
+            if (size_ >= universe_header::size + checksum_footer_size &&
+                std::equal(std::begin(checksum_magic), std::end(checksum_magic),
+                    data_ + size_ - sizeof(checksum_magic))) {
+                const char* footer = data_ + size_ - checksum_footer_size;
+                std::uint64_t offset = get_le<std::uint64_t>(footer);
+                std::uint32_t block_size = get_le<std::uint32_t>(footer+8);
+                if (block_size == 0 || offset > size_ - checksum_footer_size) {
+                    throw exception("invalid checksum footer");
+                }
+
+                std::uint64_t nblock = (offset + block_size - 1)/block_size;
+                if (offset + 4*nblock + checksum_footer_size != size_) {
+                    throw exception("invalid checksum footer");
+                }
+
+                checksum_offset_ = offset;
+                checksum_block_size_ = block_size;
+                size = offset;
+            }
+
+            header_.depth          = get_le<std::uint16_t>(data_+8);
+            header_.entry_size     = get_le<std::uint16_t>(data_+10);
+            header_.nobject        = get_le<std::uint32_t>(data_+12);
+            header_.index_offset   = get_le<std::uint64_t>(data_+16);
+            header_.records_offset = get_le<std::uint64_t>(data_+24);
+            header_.records_size   = get_le<std::uint64_t>(data_+32);
+
+            // Newer versions may append data to the entries, which we ignore
+            if (header_.entry_size < object_entry::size_on_disk) {
+                throw exception("invalid size of object entries");
+            }
+
+            if (header_.index_offset > size ||
+                std::uint64_t(header_.nobject)*header_.entry_size > size - header_.index_offset) {
+                throw exception("object index does not fit in the save file");
+            }
+
+            if (header_.records_offset > size ||
+                header_.records_size > size - header_.records_offset) {
+                throw exception("object records do not fit in the save file");
+            }
+        }
+
+        bool universe_file::is_v2(const char* data, std::size_t size) {
+            return size >= sizeof(version_header) &&
+                std::equal(std::begin(version_header), std::end(version_header), data);
+        }
+
+        const universe_header& universe_file::header() const {
+            return header_;
+        }
+
+        std::size_t universe_file::object_count() const {
+            return header_.nobject;
+        }
+
+        bool universe_file::has_checksums() const {
+            return checksum_block_size_ != 0;
+        }
+
+        void universe_file::verify() const {
+            if (!has_checksums()) return;
+
+            const std::size_t nblock =
+                (checksum_offset_ + checksum_block_size_ - 1)/checksum_block_size_;
+            const char* checksums = data_ + checksum_offset_;
+
+            // Index of the first corrupted block
+            std::atomic<std::size_t> first_corrupted(nblock);
+            tbb::parallel_for(tbb::blocked_range<std::size_t>(0, nblock, 1),
+                [&](const tbb::blocked_range<std::size_t>& r) {
+                    for (std::size_t i = r.begin(); i != r.end(); ++i) {
+                        const std::size_t begin = i*checksum_block_size_;
+                        const std::size_t size =
+                            std::min(checksum_block_size_, checksum_offset_ - begin);
+                        if (crc32c(data_ + begin, size) != get_le<std::uint32_t>(checksums+4*i)) {
+                            std::size_t prev = first_corrupted.load();
+                            while (i < prev && !first_corrupted.compare_exchange_weak(prev, i)) {}
+                        }
+                    }
+                }
+            );
+
+            if (first_corrupted != nblock) {
+                throw exception("save file is corrupted (bad checksum for block "+
+                    string::convert(first_corrupted.load()+1)+"/"+string::convert(nblock)+")");
+            }
+        }
+
+        object_entry universe_file::entry(std::size_t i) const {
+            const char* data = data_ + header_.index_offset + i*header_.entry_size;
+
+            object_entry e;
+            for (std::size_t j = 0; j < 4; ++j) {
+                e.id.data_[j] = get_le<std::uint32_t>(data+4*j);
+            }
+
+            e.position.x = get_le<space::pos_t>(data+16);
+            e.position.y = get_le<space::pos_t>(data+20);
+            e.type       = get_le<std::uint16_t>(data+24);
+            e.size       = get_le<std::uint32_t>(data+28);
+            e.offset     = get_le<std::uint64_t>(data+32);
+            return e;
+        }
+
+        const char* universe_file::record_data(const object_entry& e) const {
+            if (e.offset > header_.records_size || e.size > header_.records_size - e.offset) {
+                throw exception("record of object "+string::convert(e.id)+
+                    " does not fit in the save file");
+            }
+
+            return data_ + header_.records_offset + e.offset;
+        }
+
+        serialized_packet universe_file::read_record(const object_entry& e) const {
+            serialized_packet p;
+            p.append(record_data(e), e.size);
+            return p;
+        }
+
+        std::size_t universe_file::find(uuid_t id) const {
+            for (std::size_t i = 0; i < object_count(); ++i) {
+                const char* data = data_ + header_.index_offset + i*header_.entry_size;
+                bool match = true;
+                for (std::size_t j = 0; j < 4 && match; ++j) {
+                    match = get_le<std::uint32_t>(data+4*j) == id.data_[j];
+                }
+
+                if (match) return i;
+            }
+
+            return object_count();
+        }
+
+        std::size_t universe_file::find(const space::vec_t& pos) const {
+            std::size_t first = 0, count = object_count();
+            while (count > 0) {
+                std::size_t step = count/2;
+                if (position_less(entry(first + step).position, pos)) {
+                    first += step + 1;
+                    count -= step + 1;
+                } else {
+                    count = step;
+                }
+            }
+
+            if (first != object_count() && entry(first).position == pos) {
+                return first;
+            } else {
+                return object_count();
+            }
+        }
+    }
+
+    /// Objects serialized by a previous call to universe_serializer::save_data().
+    /** The objects are sorted by position, y first, and split into chunks of consecutive
+        objects. Each object is only serialized again if its cell has changed since the previous
+        save (see space::universe::changes_since()), and only the chunks that contain such
+        objects are rebuilt; the others are shared with the previous save. Objects are marked
+        as changed when they move, when they are looked up with universe::find_object(), or
+        when they call space_object::touch().
+    **/
+    struct universe_serializer_cache {
+        struct object {
+            space::vec_t  position;
+            uuid_t        id;
+            std::uint16_t type;
+            /// Data written by space_object::serialize()
+            std::shared_ptr<const serialized_packet> packet;
+        };
+
+        /// Consecutive objects, never modified once built.
+        using chunk = std::vector<object>;
+
+        /// Number of objects per chunk. A chunk that is rebuilt is split again if it has
+        /// grown past twice this size, and merged with its neighbour if it is less than half.
+        static constexpr std::size_t chunk_size = 256;
+
+        const space_universe* space = nullptr;
+        std::uint64_t epoch = 0;
+        std::vector<std::shared_ptr<const chunk>> chunks;
+    };
+
+    struct universe_serializer_internal_buffer {
+        std::uint16_t depth = 0;
+
+        /// Objects to write in serialize(), shared with the cache of the serializer.
+        std::vector<std::shared_ptr<const universe_serializer_cache::chunk>> saved_chunks;
+        /// Positions of the cells that changed since the previous save, sorted.
+        std::vector<space::vec_t> changed;
+        /// False if the objects were all serialized again, and 'changed' is not meaningful.
+        bool has_changes = false;
+
+        /// Objects to create in load_data_first_pass().
+        std::vector<universe_serializer_record> records;
+        /// Storage of the records of v2 files, one per save in a chain of differential saves.
+        std::vector<std::unique_ptr<v2::universe_file>> files;
+        /// Storage of the records of a v1 file.
+        std::vector<serialized_packet> packets;
+    };
 
     std::unique_ptr<universe_serializer> universe::make_serializer() {
         return std::make_unique<universe_serializer>(*this);
@@ -52,40 +368,292 @@ namespace server {
 
     universe_serializer::~universe_serializer() {}
 
+    static universe_serializer_cache::object serialize_object(const space_object& obj) {
+        auto sp = std::make_shared<serialized_packet>();
+        obj.serialize(*sp);
+
+        return {
+            obj.cell() ? obj.cell()->get_coordinates() : space::vec_t::zero,
+            obj.id(), obj.type(), std::move(sp)
+        };
+    }
+
+    // Split a sorted list of objects into chunks, and append them to the provided list.
+    static void append_chunks(universe_serializer_cache::chunk& objects,
+        std::vector<std::shared_ptr<const universe_serializer_cache::chunk>>& chunks) {
+
+        using chunk = universe_serializer_cache::chunk;
+        const std::size_t size = universe_serializer_cache::chunk_size;
+
+        if (objects.size() <= 2*size) {
+            if (!objects.empty()) chunks.push_back(std::make_shared<chunk>(std::move(objects)));
+            return;
+        }
+
+        for (std::size_t i = 0; i < objects.size(); i += size) {
+            // Do not leave a small chunk at the end
+            std::size_t last = objects.size() - i < 2*size ? objects.size() : i + size;
+            chunks.push_back(std::make_shared<chunk>(
+                std::make_move_iterator(objects.begin() + i),
+                std::make_move_iterator(objects.begin() + last)
+            ));
+            if (last == objects.size()) break;
+        }
+    }
+
+    // Serialize all the objects of the universe.
+    static void build_cache(space_universe& space, universe_serializer_cache& cache) {
+        // Start recording what changes from now on, so that the next save only has to
+        // serialize these cells again.
+        space.set_journal_enabled(true);
+        cache.space = &space;
+        cache.epoch = space.next_epoch();
+        cache.chunks.clear();
+
+        // Each thread serializes the objects it visits in its own list, and the lists are
+        // merged and sorted at the end.
+        tbb::enumerable_thread_specific<std::vector<universe_serializer_cache::object>>
+            thread_objects;
+
+        space.parallel_for_each_cell([&](const space_object& obj) {
+            thread_objects.local().push_back(serialize_object(obj));
+        });
+
+        universe_serializer_cache::chunk objects;
+        objects.reserve(space.object_count());
+        for (auto& list : thread_objects) {
+            std::move(list.begin(), list.end(), std::back_inserter(objects));
+        }
+
+        std::sort(objects.begin(), objects.end(),
+            [](const universe_serializer_cache::object& o1,
+               const universe_serializer_cache::object& o2) {
+                return position_less(o1.position, o2.position);
+            }
+        );
+
+        append_chunks(objects, cache.chunks);
+    }
+
+    // Serialize the objects whose cell changed since the previous save, and list these cells.
+    /** Only the chunks that contain a changed cell are rebuilt, so this is O(C log C + M + K),
+        where C is the number of changed cells, M the number of objects in the rebuilt chunks,
+        and K the number of chunks.
+    **/
+    static void update_cache(space_universe& space, universe_serializer_cache& cache,
+        std::vector<space::vec_t>& changed) {
+        space.changes_since(cache.epoch, changed);
+        cache.epoch = space.next_epoch();
+        space.forget_changes_before(cache.epoch);
+
+        std::sort(changed.begin(), changed.end(), position_less);
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        if (changed.empty()) return;
+
+        using chunk = universe_serializer_cache::chunk;
+        const std::size_t nchunk = cache.chunks.size();
+        std::vector<std::shared_ptr<const chunk>> chunks;
+        chunks.reserve(nchunk + 1);
+
+        // A chunk holds the cells from its first object up to the first object of the next
+        // chunk; the first chunk also holds the cells before it
+        static const chunk no_objects;
+        auto citer = changed.begin();
+        std::size_t k = 0;
+        do {
+            if (citer == changed.end()) {
+                chunks.push_back(cache.chunks[k]);
+                continue;
+            }
+
+            auto cend = changed.end();
+            if (k+1 < nchunk) {
+                const space::vec_t& next = cache.chunks[k+1]->front().position;
+                if (!position_less(*citer, next)) {
+                    chunks.push_back(cache.chunks[k]);
+                    continue;
+                }
+
+                cend = std::lower_bound(citer, changed.end(), next, position_less);
+            }
+
+            // Merge the two sorted lists, replacing the objects of the cells that changed
+            const chunk& old = k < nchunk ? *cache.chunks[k] : no_objects;
+            chunk objects;
+            objects.reserve(old.size() + (cend - citer));
+
+            auto iter = old.begin();
+            for (; citer != cend; ++citer) {
+                const space::vec_t& pos = *citer;
+                while (iter != old.end() && position_less(iter->position, pos)) {
+                    objects.push_back(*iter);
+                    ++iter;
+                }
+
+                if (iter != old.end() && !position_less(pos, iter->position)) {
+                    ++iter;
+                }
+
+                const space_cell* cell = space.try_reach(pos);
+                if (cell && !cell->empty()) {
+                    objects.push_back(serialize_object(cell->content()));
+                }
+            }
+
+            objects.insert(objects.end(), iter, old.end());
+
+            // Do not let chunks shrink too much as objects are removed
+            if (objects.size() < universe_serializer_cache::chunk_size/2 && !chunks.empty()) {
+                chunk merged = *chunks.back();
+                chunks.pop_back();
+                merged.insert(merged.end(), std::make_move_iterator(objects.begin()),
+                    std::make_move_iterator(objects.end()));
+                std::swap(merged, objects);
+            }
+
+            append_chunks(objects, chunks);
+        } while (++k < nchunk);
+
+        std::swap(chunks, cache.chunks);
+    }
+
     // NB: this function must always use the latest format
     void universe_serializer::save_data() {
         buffer_ = std::make_unique<universe_serializer_internal_buffer>();
 
         if (!universe_.space_) {
+            cache_ = nullptr;
             return;
         }
 
+        // The server has no other regular pause where no pointer to an empty cell is kept,
+        // so use the save to give the memory of the emptied cells back to the pools.
+        space_universe& space = *universe_.space_;
+        space.collapse();
+
+        // Only serialize what changed since the previous save, unless the universe has been
+        // replaced since then, or if someone stopped the journal.
+        if (!cache_ || cache_->space != &space || !space.journal_enabled()) {
+            cache_ = std::make_unique<universe_serializer_cache>();
+            build_cache(space, *cache_);
+        } else {
+            update_cache(space, *cache_, buffer_->changed);
+            buffer_->has_changes = true;
+        }
+
         // Basic info
-        buffer_->header.depth = universe_.space_->depth();
+        buffer_->depth = space.depth();
 
-        // Now explore the whole space to find objects and serialize them
-        // First find out how many objects we have to pre-allocate enough memory
-        universe_.space_->for_each_cell([&](const space_object&) {
-            ++buffer_->header.nobject;
-        });
+        // Share the serialized objects with the saving thread; this is only a copy of one
+        // pointer per chunk, and the chunks are never modified once built.
+        buffer_->saved_chunks = cache_->chunks;
+    }
 
-        buffer_->objects.reserve(buffer_->header.nobject);
+    void write_universe_file(const std::string& filename, std::uint16_t depth,
+        const std::vector<universe_serializer_record>& records, bool compress) {
 
-        // Now serialize each object
-        universe_.space_->for_each_cell([&](const space_object& obj) {
-            buffer_->objects.push_back(serialized_packet{});
-            auto& sp = buffer_->objects.back();
-            sp << obj.id();
-            if (obj.cell()) {
-                sp << obj.cell()->get_coordinates();
-            } else {
-                sp << space::vec_t::zero;
+        v2::universe_header header;
+        header.depth = depth;
+        header.entry_size = v2::object_entry::size_on_disk;
+        header.nobject = records.size();
+        header.index_offset = v2::universe_header::size;
+        header.records_offset = header.index_offset + records.size()*header.entry_size;
+        header.records_size = 0;
+        for (auto& r : records) {
+            header.records_size += r.size;
+        }
+
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("could not open '"+filename+"' for writing");
+        }
+
+        // Optionally compress everything that is written to the file
+        std::unique_ptr<block_compression::output_buffer> compressor;
+        std::ostream out(file.rdbuf());
+        if (compress) {
+            compressor = std::make_unique<block_compression::output_buffer>(file);
+            out.rdbuf(compressor.get());
+        }
+
+        serialized_packet_writer writer(out);
+
+        // Checksum everything that is written, block by block
+        std::vector<char> checksums;
+        std::uint32_t crc = 0;
+        std::size_t block_fill = 0;
+        auto write = [&](const char* data, std::size_t size) {
+            writer.write_raw(data, size);
+
+            while (size != 0) {
+                std::size_t n = std::min(size, v2::checksum_block_size - block_fill);
+                crc = crc32c(data, n, crc);
+                block_fill += n;
+                data += n;
+                size -= n;
+
+                if (block_fill == v2::checksum_block_size) {
+                    checksums.resize(checksums.size() + 4);
+                    v2::put_le(checksums.data() + checksums.size() - 4, crc);
+                    crc = 0;
+                    block_fill = 0;
+                }
             }
+        };
 
-            sp << obj.type();
+        // Write header
+        char hdata[v2::universe_header::size];
+        v2::write_header(hdata, header);
+        write(hdata, sizeof(hdata));
 
-            obj.serialize(sp);
-        });
+        // Write index
+        v2::object_entry entry;
+        char edata[v2::object_entry::size_on_disk];
+        for (auto& r : records) {
+            entry.id = r.id;
+            entry.position = r.position;
+            entry.type = r.type;
+            entry.size = r.size;
+            v2::write_entry(edata, entry);
+            write(edata, sizeof(edata));
+            entry.offset += entry.size;
+        }
+
+        // Write records
+        for (auto& r : records) {
+            write(r.data, r.size);
+        }
+
+        // Write checksums
+        if (block_fill != 0) {
+            checksums.resize(checksums.size() + 4);
+            v2::put_le(checksums.data() + checksums.size() - 4, crc);
+        }
+
+        char footer[v2::checksum_footer_size];
+        v2::put_le(footer, std::uint64_t(writer.bytes_written()));
+        v2::put_le(footer+8, std::uint32_t(v2::checksum_block_size));
+        std::copy(std::begin(v2::checksum_magic), std::end(v2::checksum_magic), footer+12);
+
+        writer.write_raw(checksums.data(), checksums.size());
+        writer.write_raw(footer, sizeof(footer));
+
+        // Make sure everything reached the disk, so that a failed save is never mistaken for
+        // a valid one
+        writer.flush();
+        if (compressor) compressor->finish();
+        file.close();
+
+        if (!out || !file) {
+            throw std::runtime_error("could not write '"+filename+"'");
+        }
+    }
+
+    static universe_serializer_record make_record(const universe_serializer_cache::object& so) {
+        return {
+            so.id, so.position, so.type,
+            so.packet->data(), so.packet->size()
+        };
     }
 
     // NB: this function must always use the latest format
@@ -94,113 +662,395 @@ namespace server {
             throw std::runtime_error("cannot serialize if save_data() has not been called");
         }
 
-        // Write header
-        std::ofstream file(dir+master_file_name, std::ios::binary);
+        std::vector<universe_serializer_record> records;
+        for (auto& c : buffer_->saved_chunks) {
+            for (auto& so : *c) {
+                records.push_back(make_record(so));
+            }
+        }
 
-        serialized_packet tp;
-        tp << buffer_->header.header << buffer_->header.depth << buffer_->header.nobject;
-        file << tp;
+        write_universe_file(dir+master_file_name, buffer_->depth, records, compression());
 
-        // Write objects
-        for (auto& so : buffer_->objects) {
-            file << so;
+        // This is not a differential save anymore, if it was
+        if (file::exists(dir+base_file_name)) {
+            file::remove(dir+base_file_name);
         }
     }
 
-    void universe_serializer::deserialize(const std::string& dir) {
-        buffer_ = std::make_unique<universe_serializer_internal_buffer>();
+    // NB: this function must always use the latest format
+    void universe_serializer::serialize_delta(const std::string& dir,
+        const std::string& base_dir) const {
+
+        if (!buffer_) {
+            throw std::runtime_error("cannot serialize if save_data() has not been called");
+        }
+
+        if (!buffer_->has_changes) {
+            // All the objects have been serialized again, we do not know what changed
+            serialize(dir);
+            return;
+        }
+
+        // Only write the cells that changed: either their new object, or a marker if they
+        // have been emptied
+        const auto& chunks = buffer_->saved_chunks;
+        std::vector<universe_serializer_record> records;
+        records.reserve(buffer_->changed.size());
+
+        std::size_t k = 0;
+        for (auto& pos : buffer_->changed) {
+            // Find the chunk that would hold this position
+            while (k+1 < chunks.size() && !position_less(pos, chunks[k+1]->front().position)) {
+                ++k;
+            }
+
+            const universe_serializer_cache::object* found = nullptr;
+            if (k < chunks.size()) {
+                const auto& objects = *chunks[k];
+                auto iter = std::lower_bound(objects.begin(), objects.end(), pos,
+                    [](const universe_serializer_cache::object& o, const space::vec_t& p) {
+                        return position_less(o.position, p);
+                    }
+                );
+
+                if (iter != objects.end() && iter->position == pos) found = &*iter;
+            }
+
+            if (found) {
+                records.push_back(make_record(*found));
+            } else {
+                records.push_back({uuid_t{}, pos, v2::removed_type, nullptr, 0});
+            }
+        }
+
+        write_universe_file(dir+master_file_name, buffer_->depth, records, compression());
+
+        std::ofstream base(dir+base_file_name);
+        base << base_dir;
+    }
+
+    // Read the records of a v2 file from the mapping, without copying them.
+    static void deserialize_v2(universe_serializer_internal_buffer& buffer,
+        mapped_file mapped, std::vector<universe_serializer_record>& records) {
+
+        try {
+            buffer.files.push_back(std::make_unique<v2::universe_file>(std::move(mapped)));
+            const v2::universe_file& file = *buffer.files.back();
+            file.verify();
+
+            buffer.depth = file.header().depth;
+            records.resize(file.object_count());
+            for (std::size_t i = 0; i < file.object_count(); ++i) {
+                v2::object_entry e = file.entry(i);
+                records[i] = {e.id, e.position, e.type, file.record_data(e), e.size};
+            }
+        } catch (v2::universe_file::exception& e) {
+            throw request::server::game_load::failure{
+                request::server::game_load::failure::reason::invalid_saved_game, e.what()
+            };
+        }
+    }
+
+    static void deserialize_v1(universe_serializer_internal_buffer& buffer,
+        const std::string& filename) {
+
+        v1::universe_header header;
 
         // Read file
-        std::ifstream file(dir+master_file_name, std::ios::binary);
+        std::ifstream file(filename, std::ios::binary);
 
         serialized_packet phdr;
         file >> phdr;
-        if (!(phdr >> buffer_->header.header)) {
+        if (!(phdr >> header.header)) {
             throw request::server::game_load::failure{
                 request::server::game_load::failure::reason::invalid_saved_game,
                 "could not read save format version"
             };
         }
 
-        if (buffer_->header.header == v1::version_header) {
-            if (!(phdr >> buffer_->header.depth)) {
-                throw request::server::game_load::failure{
-                    request::server::game_load::failure::reason::invalid_saved_game,
-                    "could not read universe size"
-                };
+        if (header.header != v1::version_header) {
+            throw request::server::game_load::failure{
+                request::server::game_load::failure::reason::invalid_saved_game,
+                "unsupported save file version"
+            };
+        }
+
+        if (!(phdr >> header.depth)) {
+            throw request::server::game_load::failure{
+                request::server::game_load::failure::reason::invalid_saved_game,
+                "could not read universe size"
+            };
+        };
+
+        if (!(phdr >> header.nobject)) {
+            throw request::server::game_load::failure{
+                request::server::game_load::failure::reason::invalid_saved_game,
+                "could not read number of objects in universe"
             };
+        };
 
-            if (!(phdr >> buffer_->header.nobject)) {
+        buffer.depth = header.depth;
+        buffer.packets.resize(header.nobject);
+        buffer.records.resize(header.nobject);
+
+        std::size_t i = 0;
+        for (auto& so : buffer.packets) {
+            file >> so;
+
+            auto& r = buffer.records[i];
+            ++i;
+
+            if (!(so >> r.id >> r.position >> r.type)) {
                 throw request::server::game_load::failure{
                     request::server::game_load::failure::reason::invalid_saved_game,
-                    "could not read number of objects in universe"
+                    "could not read generic object properties for object "+
+                    string::convert(i)+"/"+string::convert(buffer.packets.size())
                 };
-            };
+            }
+
+            r.data = so.data() + so.tellg();
+            r.size = so.size() - so.tellg();
+        }
+    }
+
+    static bool record_less(const universe_serializer_record& r1,
+        const universe_serializer_record& r2) {
+        return position_less(r1.position, r2.position);
+    }
+
+    // Read the directory of the save that the differential save in 'dir' is based on.
+    static std::string read_base_directory(const std::string& dir) {
+        std::string base_dir;
+        std::ifstream base(dir+base_file_name);
+        std::getline(base, base_dir);
+        return base_dir;
+    }
 
-            buffer_->objects.resize(buffer_->header.nobject);
-            for (auto& so : buffer_->objects) {
-                file >> so;
+    // Read the records of the save in 'dir', and of all the saves it is based on.
+    static void deserialize_chain(universe_serializer_internal_buffer& buffer,
+        const std::string& dir, std::size_t chain_length) {
+
+        const std::string filename = dir+master_file_name;
+
+        if (!file::exists(dir+base_file_name)) {
+            // Full save
+            mapped_file mapped(filename);
+            if (v2::universe_file::is_v2(mapped.data(), mapped.size()) ||
+                block_compression::is_compressed(mapped.data(), mapped.size())) {
+                deserialize_v2(buffer, std::move(mapped), buffer.records);
+            } else {
+                deserialize_v1(buffer, filename);
             }
-        } else {
+
+            return;
+        }
+
+        // Differential save, read the base first
+        if (chain_length == max_chain_length) {
             throw request::server::game_load::failure{
                 request::server::game_load::failure::reason::invalid_saved_game,
-                "unsupported save file version"
+                "too many differential saves, or circular differential saves"
+            };
+        }
+
+        const std::string base_dir = read_base_directory(dir);
+        if (base_dir.empty() || !file::exists(base_dir+master_file_name)) {
+            throw request::server::game_load::failure{
+                request::server::game_load::failure::reason::invalid_saved_game,
+                "missing base of differential save '"+dir+"' ('"+base_dir+"')"
+            };
+        }
+
+        deserialize_chain(buffer, base_dir, chain_length+1);
+        const std::uint16_t base_depth = buffer.depth;
+
+        std::vector<universe_serializer_record> delta;
+        mapped_file mapped(filename);
+        if (!v2::universe_file::is_v2(mapped.data(), mapped.size()) &&
+            !block_compression::is_compressed(mapped.data(), mapped.size())) {
+            throw request::server::game_load::failure{
+                request::server::game_load::failure::reason::invalid_saved_game,
+                "unsupported version of differential save '"+dir+"'"
+            };
+        }
+
+        deserialize_v2(buffer, std::move(mapped), delta);
+        if (buffer.depth != base_depth) {
+            throw request::server::game_load::failure{
+                request::server::game_load::failure::reason::invalid_saved_game,
+                "differential save '"+dir+"' does not have the same depth as its base"
             };
         }
+
+        merge_universe_delta(buffer.records, delta);
+    }
+
+    void merge_universe_delta(std::vector<universe_serializer_record>& records,
+        std::vector<universe_serializer_record>& delta) {
+        // Replace the cells of the base that changed in the delta; both are sorted by
+        // position, except old v1 saves which are sorted here just in case
+        if (!std::is_sorted(records.begin(), records.end(), record_less)) {
+            std::stable_sort(records.begin(), records.end(), record_less);
+        }
+
+        if (!std::is_sorted(delta.begin(), delta.end(), record_less)) {
+            std::stable_sort(delta.begin(), delta.end(), record_less);
+        }
+
+        std::vector<universe_serializer_record> merged;
+        merged.reserve(records.size() + delta.size());
+
+        auto iter = records.begin();
+        for (auto& r : delta) {
+            while (iter != records.end() && record_less(*iter, r)) {
+                merged.push_back(*iter);
+                ++iter;
+            }
+
+            while (iter != records.end() && !record_less(r, *iter)) {
+                ++iter;
+            }
+
+            if (r.type != v2::removed_type) {
+                merged.push_back(r);
+            }
+        }
+
+        std::copy(iter, records.end(), std::back_inserter(merged));
+        std::swap(merged, records);
+    }
+
+    void universe_serializer::deserialize(const std::string& dir) {
+        buffer_ = std::make_unique<universe_serializer_internal_buffer>();
+        deserialize_chain(*buffer_, dir, 0);
+    }
+
+    void universe_serializer::compact(const std::string& dir) {
+        if (!file::exists(dir+base_file_name)) return;
+
+        const std::string filename = dir+master_file_name;
+        const std::string tmp_filename = filename+".tmp";
+
+        // Use a buffer of our own, since this may run while a save is in progress (see
+        // server::state::game::save_to_directory()), and 'buffer_' holds its data
+        {
+            universe_serializer_internal_buffer buffer;
+            deserialize_chain(buffer, dir, 0);
+
+            // Write in a temporary file first, since the current file is still being read
+            try {
+                write_universe_file(tmp_filename, buffer.depth, buffer.records, compression());
+            } catch (...) {
+                // Leave the differential save untouched
+                file::remove(tmp_filename);
+                throw;
+            }
+        }
+
+        // The delta must stay readable until the new file is in place: rename() replaces
+        // the target atomically on POSIX, elsewhere it fails and the original file is moved
+        // aside first, then restored if the swap does not go through
+        if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+            const std::string old_filename = filename+".old";
+            if (std::rename(filename.c_str(), old_filename.c_str()) != 0) {
+                file::remove(tmp_filename);
+                throw std::runtime_error("could not replace '"+filename+"'");
+            }
+
+            if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+                std::rename(old_filename.c_str(), filename.c_str());
+                file::remove(tmp_filename);
+                throw std::runtime_error("could not replace '"+filename+"'");
+            }
+
+            file::remove(old_filename);
+        }
+
+        file::remove(dir+base_file_name);
+    }
+
+    std::string universe_serializer::base_directory(const std::string& dir) const {
+        if (!file::exists(dir+base_file_name)) return "";
+        return read_base_directory(dir);
     }
 
     // NB: this function must always use the latest format
     void universe_serializer::load_data_first_pass() {
-        if (!universe_.create_space(buffer_->header.depth)) {
+        cache_ = nullptr;
+
+        if (!universe_.create_space(buffer_->depth)) {
             throw request::server::game_load::failure{
                 request::server::game_load::failure::reason::invalid_saved_game,
-                "the depth of the universe must be comprised between 2 and 16"
+                "the depth of the universe must be comprised between "+
+                string::convert(universe::min_depth)+" and "+string::convert(universe::max_depth)
             };
         }
 
-        // Create objects
-        std::size_t i = 0;
-        for (auto& so : buffer_->objects) {
-            ++i;
-            uuid_t id;
-            space::vec_t pos;
-            std::uint16_t type;
+        // Create and decode objects in parallel. Each object is decoded in its own slot, so
+        // the order of the records is preserved, and each thread reuses the same packet to
+        // hold the records it decodes.
+        const auto& records = buffer_->records;
+        const std::size_t nrecord = records.size();
+        std::vector<space_universe::positioned_object> objects(nrecord);
 
-            if (!(so >> id >> pos >> type)) {
-                throw request::server::game_load::failure{
-                    request::server::game_load::failure::reason::invalid_saved_game,
-                    "could not read generic object properties for object "+
-                    string::convert(i)+"/"+string::convert(buffer_->objects.size())
-                };
+        // Index of the first record with an invalid type, to report the same error as a
+        // sequential load would
+        std::atomic<std::size_t> first_invalid(nrecord);
+        tbb::enumerable_thread_specific<serialized_packet> thread_packets;
+
+        tbb::parallel_for(tbb::blocked_range<std::size_t>(0, nrecord),
+            [&](const tbb::blocked_range<std::size_t>& range) {
+                serialized_packet& so = thread_packets.local();
+                for (std::size_t i = range.begin(); i != range.end(); ++i) {
+                    if (i > first_invalid.load(std::memory_order_relaxed)) return;
+
+                    const universe_serializer_record& r = records[i];
+                    std::unique_ptr<space_object> ptr =
+                        universe_.object_factory_->make(r.type, r.id);
+                    if (!ptr) {
+                        std::size_t prev = first_invalid.load();
+                        while (i < prev && !first_invalid.compare_exchange_weak(prev, i)) {}
+                        return;
+                    }
+
+                    so.clear();
+                    so.append(r.data, r.size);
+                    ptr->deserialize(so);
+                    objects[i] = std::make_pair(r.position, std::move(ptr));
+                }
             }
+        );
+
+        if (first_invalid < nrecord) {
+            const universe_serializer_record& r = records[first_invalid];
+            throw request::server::game_load::failure{
+                request::server::game_load::failure::reason::invalid_saved_game,
+                "invalid object type code for object "+string::convert(r.id)+
+                " ("+string::convert(r.type)+")"
+            };
+        }
+
+        // Place them all in the universe at once
+        if (universe_.space_->bulk_fill(objects) == 0) return;
+
+        for (auto& o : objects) {
+            if (!o.second) continue;
 
-            space_cell* cell = universe_.space_->try_reach(pos);
-            if (!cell) {
+            if (!universe_.space_->contains(o.first)) {
                 throw request::server::game_load::failure{
                     request::server::game_load::failure::reason::invalid_saved_game,
-                    "invalid position for object "+string::convert(id)+
-                    " ("+string::convert(pos)+"), out of universe"
+                    "invalid position for object "+string::convert(o.second->id())+
+                    " ("+string::convert(o.first)+"), out of universe"
                 };
-            } else if (!cell->empty()) {
+            } else {
+                space_cell* cell = universe_.space_->try_reach(o.first);
                 throw request::server::game_load::failure{
                     request::server::game_load::failure::reason::invalid_saved_game,
-                    "invalid position for object "+string::convert(id)+
-                    " ("+string::convert(pos)+"), object "+
+                    "invalid position for object "+string::convert(o.second->id())+
+                    " ("+string::convert(o.first)+"), object "+
                     string::convert(cell->content().id())+" is already there"
                 };
             }
-
-            std::unique_ptr<space_object> ptr = universe_.object_factory_->make(type, id);
-            if (!ptr) {
-                throw request::server::game_load::failure{
-                    request::server::game_load::failure::reason::invalid_saved_game,
-                    "invalid object type code for object "+string::convert(id)+
-                    " ("+string::convert(type)+")"
-                };
-            }
-
-            ptr->deserialize(so);
-            cell->fill(std::move(ptr));
         }
     }
 
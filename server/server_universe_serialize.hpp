@@ -2,6 +2,9 @@
 #define SERVER_UNIVERSE_SERIALIZE_HPP
 
 #include "server_universe.hpp"
+#include <serialized_packet.hpp>
+#include <filesystem.hpp>
+#include <stdexcept>
 
 namespace server {
     namespace v1 {
@@ -12,12 +15,170 @@ namespace server {
             std::uint16_t depth  = 0;
             std::uint32_t nobject = 0;
         };
+    }
+
+    /// Indexed save format, designed to be mapped in memory and decoded in place.
+    /** The file is made of three contiguous parts:
+         - a fixed size header (universe_header),
+         - an index with one fixed size entry per object (object_entry), sorted by position,
+           y first,
+         - the records, i.e., the data written by space_object::serialize() for each object.
+        A differential save has the same layout, but only contains the cells that changed since
+        its base save, and the directory of the base save is written in a separate file.
+        All the integers of the header and the index are stored in little endian. The records
+        use the usual serialized_packet encoding.
+
+        The file ends with checksums: the CRC-32C (see crc32c()) of each block of
+        checksum_block_size bytes of the three parts above, followed by a footer holding the
+        position of the checksums, the block size, and checksum_magic. Files written without
+        checksums are still accepted.
+    **/
+    namespace v2 {
+        static const char version_header[8] = {'S', 'C', 'U', 'V', '2', 0, 0, 0};
+
+        /// Type of the entries that mark an emptied cell, in a differential save.
+        /** These entries have no record.
+        **/
+        static const std::uint16_t removed_type = 0xffff;
+
+        /// Size of the blocks of the file that are checksummed separately.
+        static const std::size_t checksum_block_size = 1 << 20;
+        /// Marks the end of the checksum footer.
+        static const char checksum_magic[4] = {'C', 'R', 'C', 'C'};
+        /// Size of the checksum footer, in bytes.
+        static const std::size_t checksum_footer_size = 16;
 
-        struct universe_serializer_internal_buffer {
-            universe_header header;
-            std::vector<serialized_packet> objects;
+        struct universe_header {
+            std::uint16_t depth = 0;
+            std::uint16_t entry_size = 0;
+            std::uint32_t nobject = 0;
+            std::uint64_t index_offset = 0;
+            std::uint64_t records_offset = 0;
+            std::uint64_t records_size = 0;
+
+            /// Size of the header on disk, in bytes, including the version header.
+            static constexpr std::size_t size = 40;
+        };
+
+        struct object_entry {
+            uuid_t        id;
+            space::vec_t  position;
+            std::uint16_t type = 0;
+            std::uint32_t size = 0;
+            /// Position of the record, relative to the beginning of the records.
+            std::uint64_t offset = 0;
+
+            /// Size of an entry on disk, in bytes.
+            static constexpr std::size_t size_on_disk = 40;
+        };
+
+        /// Encode the header in 'out', which must hold at least universe_header::size bytes.
+        void write_header(char* out, const universe_header& header);
+
+        /// Encode the entry in 'out', which must hold at least object_entry::size_on_disk bytes.
+        void write_entry(char* out, const object_entry& entry);
+
+        /// Random access to the objects of a saved universe.
+        /** The file is mapped in memory, and only the parts that are accessed are read from
+            the disk. Reading a single object does not read the rest of the file. Compressed
+            files (see block_compression) are decompressed in memory first.
+        **/
+        class universe_file {
+            mapped_file file_;
+            std::vector<char> decompressed_;
+            const char* data_ = nullptr;
+            std::size_t size_ = 0;
+            universe_header header_;
+            std::size_t checksum_offset_ = 0;
+            std::size_t checksum_block_size_ = 0;
+
+            void check_();
+
+        public :
+            struct exception : std::runtime_error {
+                explicit exception(const std::string& msg);
+            };
+
+            /// Map and check the provided file.
+            /** \throw exception if the file cannot be opened, or is not a valid v2 file
+            **/
+            explicit universe_file(const std::string& filename);
+
+            /// Check the provided mapped file, and take ownership of it.
+            /** \throw exception if the file is not a valid v2 file
+            **/
+            explicit universe_file(mapped_file mapped);
+
+            /// Check the provided decompressed file content, and take ownership of it.
+            /** \throw exception if the content is not a valid v2 file
+            **/
+            explicit universe_file(std::vector<char> content);
+
+            /// Check if the provided data starts with the v2 version header.
+            static bool is_v2(const char* data, std::size_t size);
+
+            const universe_header& header() const;
+
+            std::size_t object_count() const;
+
+            /// Check if the file contains checksums.
+            bool has_checksums() const;
+
+            /// Check all the blocks of the file against their checksum, in parallel.
+            /** \throw exception if a block is corrupted
+                \note This reads the whole file. It does nothing if there are no checksums.
+            **/
+            void verify() const;
+
+            /// Decode the entry of the i-th object from the index.
+            object_entry entry(std::size_t i) const;
+
+            /// Return a pointer to the record of the provided object, inside the mapping.
+            /** \throw exception if the record does not fit inside the file
+            **/
+            const char* record_data(const object_entry& e) const;
+
+            /// Copy the record of the provided object in a packet.
+            serialized_packet read_record(const object_entry& e) const;
+
+            /// Find the object with the provided id.
+            /** \return The index of the object, or object_count() if not found.
+                \note This is linear in the number of objects, but only reads the index.
+            **/
+            std::size_t find(uuid_t id) const;
+
+            /// Find the object at the provided position.
+            /** \return The index of the object, or object_count() if not found.
+                \note This is a binary search in the index.
+            **/
+            std::size_t find(const space::vec_t& pos) const;
         };
     }
+
+    /// An object read from the save file, before it is created.
+    struct universe_serializer_record {
+        uuid_t        id;
+        space::vec_t  position;
+        std::uint16_t type;
+        /// Data written by space_object::serialize(), inside the mapped file or a v1 packet
+        const char*   data;
+        std::size_t   size;
+    };
+
+    /// Write a v2 file containing the provided records, which must be sorted by position.
+    /** \param compress Set to 'true' to compress the file (see block_compression)
+        	hrow std::runtime_error if the file cannot be opened, or if any write fails
+    **/
+    void write_universe_file(const std::string& filename, std::uint16_t depth,
+        const std::vector<universe_serializer_record>& records, bool compress);
+
+    /// Apply the records of a differential save on top of those of its base.
+    /** Each cell listed in 'delta' replaces the cell at the same position in 'records', or is
+        removed if its type is v2::removed_type. Both lists are sorted by position first, if
+        they are not already.
+    **/
+    void merge_universe_delta(std::vector<universe_serializer_record>& records,
+        std::vector<universe_serializer_record>& delta);
 }
 
 #endif
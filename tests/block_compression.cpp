@@ -0,0 +1,149 @@
+#include <block_compression.hpp>
+#include <xorshift.hpp>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "test.hpp"
+
+namespace {
+    std::vector<char> random_data(std::size_t size, std::uint32_t seed) {
+        xorshift rng(seed);
+        std::vector<char> data(size);
+        for (auto& c : data) c = char(rng() & 0xff);
+        return data;
+    }
+
+    std::vector<char> repeated_data(std::size_t size, const std::string& pattern) {
+        std::vector<char> data(size);
+        for (std::size_t i = 0; i < size; ++i) data[i] = pattern[i % pattern.size()];
+        return data;
+    }
+
+    std::string compress(const std::vector<char>& data, std::size_t block_size) {
+        std::ostringstream ss;
+        {
+            block_compression::output_buffer buffer(ss, block_size);
+            std::ostream out(&buffer);
+            out.write(data.data(), data.size());
+            buffer.finish();
+        }
+
+        return ss.str();
+    }
+
+    // Decompress the stream, and return false if it threw block_compression::exception
+    bool try_decompress(const std::string& stream, std::vector<char>& result) {
+        try {
+            result = block_compression::decompress(stream.data(), stream.size());
+            return true;
+        } catch (block_compression::exception&) {
+            return false;
+        }
+    }
+
+    // Compress the data both as a single block and as a stream, and check that it decompresses
+    // to the same data. Return the size of the stream.
+    std::size_t check_round_trip(const std::vector<char>& data, std::size_t block_size) {
+        std::vector<char> block(block_compression::max_compressed_size(data.size()));
+        std::size_t size = block_compression::compress_block(data.data(), data.size(),
+            block.data());
+        CHECK(size <= block.size());
+
+        std::vector<char> decompressed(data.size());
+        CHECK(block_compression::decompress_block(block.data(), size, decompressed.data(),
+            decompressed.size()));
+        CHECK(decompressed == data);
+
+        std::string stream = compress(data, block_size);
+        CHECK(block_compression::is_compressed(stream.data(), stream.size()));
+
+        std::vector<char> result;
+        CHECK(try_decompress(stream, result));
+        CHECK(result == data);
+
+        return stream.size();
+    }
+
+    void test_round_trip() {
+        const std::size_t block_size = 4096;
+
+        // Empty and tiny inputs, shorter than the minimum match
+        for (std::size_t size : {0, 1, 4, 5, 12, 13, 16}) {
+            check_round_trip(repeated_data(size, "a"), block_size);
+            check_round_trip(random_data(size, 1), block_size);
+        }
+
+        // Incompressible data is stored as is, with only the block headers added
+        const std::size_t size = 20*block_size + 123;
+        std::size_t stored = check_round_trip(random_data(size, 2), block_size);
+        CHECK(stored <= size + 8*(size/block_size + 3));
+
+        // Repetitive data, including matches that overlap with themselves
+        CHECK(check_round_trip(repeated_data(size, "a"), block_size) < size/50);
+        CHECK(check_round_trip(repeated_data(size, "abc"), block_size) < size/50);
+        CHECK(check_round_trip(repeated_data(size, "0123456789abcdefghij"), block_size) <
+            size/20);
+
+        // Long literal runs and long matches, mixed
+        std::vector<char> mixed = random_data(size, 3);
+        std::vector<char> run = repeated_data(1000, "xy");
+        for (std::size_t i = 0; i + run.size() < mixed.size(); i += 3*run.size()) {
+            std::copy(run.begin(), run.end(), mixed.begin() + i);
+        }
+
+        check_round_trip(mixed, block_size);
+    }
+
+    void test_corrupted() {
+        const std::size_t block_size = 4096;
+        std::vector<char> data = repeated_data(3*block_size, "hello world, ");
+        std::copy_n(random_data(500, 4).begin(), 500, data.begin() + block_size);
+        const std::string stream = compress(data, block_size);
+        std::vector<char> result;
+
+        // Not a compressed stream
+        CHECK(!try_decompress("", result));
+        CHECK(!try_decompress(std::string("CBC2") + stream.substr(4), result));
+
+        // Truncated anywhere
+        for (std::size_t size = 0; size < stream.size(); ++size) {
+            CHECK(!try_decompress(stream.substr(0, size), result));
+        }
+
+        // Block larger than the block size, or decompressing to a different size
+        std::string bad = stream;
+        bad[8+1] = char(0x20);
+        CHECK(!try_decompress(bad, result));
+
+        bad = stream;
+        bad[8] = char(0xff);
+        bad[8+1] = char(0x0f);
+        CHECK(!try_decompress(bad, result));
+
+        // Any flipped bit is either detected, or decodes to data of the same size
+        for (std::size_t i = 0; i < stream.size(); ++i) {
+            for (std::size_t b = 0; b < 8; b += 3) {
+                bad = stream;
+                bad[i] = char(bad[i] ^ (1 << b));
+                if (try_decompress(bad, result)) {
+                    CHECK(result.size() == data.size());
+                }
+            }
+        }
+
+        // A block never reads or writes outside of its buffers
+        std::vector<char> block(block_compression::max_compressed_size(data.size()));
+        std::size_t size = block_compression::compress_block(data.data(), data.size(),
+            block.data());
+        std::vector<char> out(data.size());
+        CHECK(!block_compression::decompress_block(block.data(), size, out.data(), out.size()-1));
+        CHECK(!block_compression::decompress_block(block.data(), size-1, out.data(), out.size()));
+    }
+}
+
+int main() {
+    test_round_trip();
+    test_corrupted();
+    return test_failures() == 0 ? 0 : 1;
+}
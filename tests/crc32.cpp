@@ -0,0 +1,71 @@
+#include <crc32.hpp>
+#include <xorshift.hpp>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "test.hpp"
+
+namespace {
+    // Bit by bit CRC-32C, to compare against
+    std::uint32_t reference_crc32c(const char* data, std::size_t size, std::uint32_t crc = 0) {
+        crc = ~crc;
+        for (std::size_t i = 0; i < size; ++i) {
+            crc ^= static_cast<unsigned char>(data[i]);
+            for (std::size_t j = 0; j < 8; ++j) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78u : crc >> 1;
+            }
+        }
+
+        return ~crc;
+    }
+
+    void test_check_value() {
+        const char* check = "123456789";
+        CHECK(crc32c(check, std::strlen(check)) == 0xE3069283u);
+        CHECK(reference_crc32c(check, std::strlen(check)) == 0xE3069283u);
+        CHECK(crc32c(nullptr, 0) == 0);
+        CHECK(crc32c(check, 0, 0x12345678u) == 0x12345678u);
+    }
+
+    void test_random_data() {
+        xorshift rng(42);
+        std::vector<char> data(4096 + 64);
+        for (auto& c : data) c = char(rng() & 0xff);
+
+        // All the sizes around the 8 byte steps, at all the alignments
+        for (std::size_t offset = 0; offset < 8; ++offset) {
+            for (std::size_t size : {1, 7, 8, 9, 15, 16, 17, 63, 64, 65, 1000, 4096}) {
+                const char* p = data.data() + offset;
+                CHECK(crc32c(p, size) == reference_crc32c(p, size));
+            }
+        }
+    }
+
+    void test_chained() {
+        xorshift rng(7);
+        std::vector<char> data(10000);
+        for (auto& c : data) c = char(rng() & 0xff);
+
+        const std::uint32_t whole = crc32c(data.data(), data.size());
+        for (std::size_t split : {0, 1, 3, 8, 13, 4096, 9999, 10000}) {
+            std::uint32_t crc = crc32c(data.data(), split);
+            crc = crc32c(data.data() + split, data.size() - split, crc);
+            CHECK(crc == whole);
+        }
+
+        // Many small pieces, as when checksumming a file block by block
+        std::uint32_t crc = 0;
+        for (std::size_t i = 0; i < data.size(); i += 37) {
+            crc = crc32c(data.data() + i, std::min(std::size_t(37), data.size() - i), crc);
+        }
+
+        CHECK(crc == whole);
+    }
+}
+
+int main() {
+    test_check_value();
+    test_random_data();
+    test_chained();
+    return test_failures() == 0 ? 0 : 1;
+}
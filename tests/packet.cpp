@@ -0,0 +1,132 @@
+#include <packet.hpp>
+#include <color32.hpp>
+#include <sorted_vector.hpp>
+#include <algorithm>
+#include <limits>
+#include "test.hpp"
+
+namespace {
+    enum class reason : std::uint16_t {
+        first, second = 513
+    };
+
+    /// Write the values with packet_write() and packet_write_exact(), check that both give
+    /// the same bytes, and return the packet.
+    template<typename ... Args>
+    serialized_packet write_both(const Args& ... args) {
+        static_assert(packet_impl::all_supported<Args...>(), "type not supported");
+
+        serialized_packet p, q;
+        packet_write(p, args...);
+        packet_write_exact(q, args...);
+
+        CHECK(p.size() == q.size());
+        CHECK(p.size() == (std::size_t(0) + ... + packet_impl::serialized<Args>::size(args)));
+        CHECK(std::equal(p.data(), p.data() + std::min(p.size(), q.size()), q.data()));
+
+        return q;
+    }
+
+    template<typename C>
+    bool same_elements(const C& c1, const C& c2) {
+        return c1.size() == c2.size() && std::equal(c1.begin(), c1.end(), c2.begin());
+    }
+
+    // Bounded types are written with exactly max_size() bytes
+    void test_scalars() {
+        const std::uint8_t u8 = 200;
+        const std::int16_t i16 = -12345;
+        const std::uint32_t u32 = 0xdeadbeef;
+        const std::int64_t i64 = std::numeric_limits<std::int64_t>::min() + 7;
+        const std::uint64_t u64 = 0x0102030405060708ull;
+        const float f = 1.5f;
+        const double d = -3.25;
+        const bool b = true;
+        const reason r = reason::second;
+        const color32 c(9, 8, 7, 6);
+        const ctl::empty_t e;
+
+        serialized_packet p = write_both(u8, i16, u32, i64, u64, f, d, b, r, c, e);
+        CHECK((p.size() == packet_impl::max_size_of<std::uint8_t, std::int16_t, std::uint32_t,
+            std::int64_t, std::uint64_t, float, double, bool, reason, color32, ctl::empty_t>()));
+        CHECK(p.size() == 1 + 2 + 4 + 8 + 8 + 4 + 8 + 1 + 2 + 4 + 0);
+
+        // Integers are big endian
+        CHECK(static_cast<unsigned char>(p.data()[7+8]) == 0x01);
+        CHECK(static_cast<unsigned char>(p.data()[7+15]) == 0x08);
+
+        std::uint8_t ru8 = 0; std::int16_t ri16 = 0; std::uint32_t ru32 = 0;
+        std::int64_t ri64 = 0; std::uint64_t ru64 = 0; float rf = 0; double rd = 0;
+        bool rb = false; reason rr = reason::first; color32 rc; ctl::empty_t re;
+        packet_read(p, ru8, ri16, ru32, ri64, ru64, rf, rd, rb, rr, rc, re);
+        CHECK(p);
+        CHECK(p.end_of_packet());
+        CHECK(ru8 == u8 && ri16 == i16 && ru32 == u32 && ri64 == i64 && ru64 == u64);
+        CHECK(rf == f && rd == d && rb == b && rr == r && rc == c);
+    }
+
+    // Containers of bulk types are encoded in one go, the others element by element
+    void test_containers() {
+        const std::string s = "cobalt";
+        const std::vector<std::uint16_t> vu16 = {1, 2, 0xfffe};
+        const std::vector<std::string> vs = {"a", "", "bcd"};
+        const std::vector<color32> vc = {color32(1, 2, 3, 4), color32(5, 6, 7, 8)};
+        const std::array<std::int32_t,3> ai = {{-1, 0, 1}};
+        const std::array<std::string,2> as = {{"x", "yz"}};
+
+        ctl::sorted_vector<std::string> ss;
+        ss.insert("save2/");
+        ss.insert("save1/");
+
+        ctl::sorted_vector<std::int32_t> si;
+        si.insert(3);
+        si.insert(-3);
+
+        serialized_packet p = write_both(s, vu16, vs, vc, ai, as, ss, si);
+
+        std::string rs; std::vector<std::uint16_t> rvu16; std::vector<std::string> rvs;
+        std::vector<color32> rvc; std::array<std::int32_t,3> rai;
+        std::array<std::string,2> ras; ctl::sorted_vector<std::string> rss;
+        ctl::sorted_vector<std::int32_t> rsi;
+        packet_read(p, rs, rvu16, rvs, rvc, rai, ras, rss, rsi);
+        CHECK(p);
+        CHECK(p.end_of_packet());
+        CHECK(rs == s && rvu16 == vu16 && rvs == vs && rvc == vc);
+        CHECK(rai == ai && ras == as);
+        CHECK(same_elements(rss, ss));
+        CHECK(same_elements(rsi, si));
+
+        // The same data must be readable through a view
+        p.seekg(0);
+        serialized_packet_view v = p.view();
+        std::vector<std::string> vvs; ctl::sorted_vector<std::string> vss;
+        v >> rs >> rvu16 >> vvs >> rvc >> rai >> ras >> vss;
+        CHECK(v);
+        CHECK(vvs == vs);
+        CHECK(same_elements(vss, ss));
+
+        // Empty containers
+        serialized_packet e = write_both(std::vector<std::uint32_t>{},
+            ctl::sorted_vector<std::string>{}, std::string{});
+        CHECK(e.size() == 3*sizeof(std::uint32_t));
+    }
+
+    void test_atomic() {
+        const std::atomic<std::uint32_t> a(0x01020304);
+        serialized_packet p = write_both(a);
+        CHECK(p.size() == sizeof(std::uint32_t));
+
+        std::atomic<std::uint32_t> r(0);
+        p >> r;
+        CHECK(p);
+        CHECK(r == 0x01020304u);
+    }
+}
+
+int main() {
+    test_scalars();
+    test_containers();
+    test_atomic();
+
+    return test_failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,350 @@
+#include <server_space_object.hpp>
+#include <server_universe.hpp>
+#include <server_universe_serialize.hpp>
+#include <serialized_packet.hpp>
+#include <filesystem.hpp>
+#include <fstream>
+#include <iterator>
+#include "test.hpp"
+
+namespace {
+    struct test_object : server::space_object {
+        std::int32_t value = 0;
+
+        explicit test_object(uuid_t id) : server::space_object(id) {}
+
+        void serialize(serialized_packet& p) const override {
+            p << value;
+        }
+
+        void deserialize(serialized_packet& p) override {
+            p >> value;
+        }
+
+        std::uint16_t type() const override {
+            return 0;
+        }
+    };
+
+    // An object cleared while readers are active is kept alive for them, but must not be
+    // found in the index anymore
+    void test_index_clear_with_readers() {
+        // NB: the index must outlive the objects, hence it is declared first
+        server::space_object_index index;
+        server::space_object_factory factory(&index);
+        factory.add_factory<test_object>(0);
+
+        auto u = server::space_universe::make<4>();
+        u->set_concurrent_reads(true);
+
+        std::unique_ptr<server::space_object> obj = factory.make(0);
+        const uuid_t id = obj->id();
+        server::space_cell& c = u->reach(space::vec_t(1,1));
+        c.fill(std::move(obj));
+        CHECK(index.find(id) == &c.content());
+        CHECK(index.find(id)->cell() == &c);
+
+        {
+            auto guard = u->read();
+            c.clear();
+            CHECK(index.find(id) == nullptr);
+            CHECK(index.size() == 0);
+        }
+
+        u->collapse();
+        CHECK(index.find(id) == nullptr);
+    }
+
+    uuid_t make_id(std::uint32_t i) {
+        uuid_t id;
+        id.data_ = {{i, i+1, i+2, i+3}};
+        return id;
+    }
+
+    serialized_packet make_data(std::int32_t value) {
+        serialized_packet p;
+        p << value << std::string(value, 'x');
+        return p;
+    }
+
+    server::universe_serializer_record make_record(std::uint32_t i, const space::vec_t& pos,
+        const serialized_packet& p) {
+        return {make_id(i), pos, std::uint16_t(i % 3), p.data(), p.size()};
+    }
+
+    // Check that the record of the i-th object of the file holds the provided data
+    bool same_record(const server::v2::universe_file& f, std::size_t i,
+        const server::universe_serializer_record& r) {
+        if (i >= f.object_count()) return false;
+
+        server::v2::object_entry e = f.entry(i);
+        return e.id == r.id && e.position == r.position && e.type == r.type &&
+            e.size == r.size && std::equal(r.data, r.data + r.size, f.record_data(e));
+    }
+
+    std::vector<server::universe_serializer_record> read_records(
+        const server::v2::universe_file& f) {
+        std::vector<server::universe_serializer_record> records;
+        for (std::size_t i = 0; i < f.object_count(); ++i) {
+            server::v2::object_entry e = f.entry(i);
+            records.push_back({e.id, e.position, e.type, f.record_data(e), e.size});
+        }
+
+        return records;
+    }
+
+    // Write a v2 file, read it back, and apply a differential save on top of it
+    void test_v2_round_trip(bool compress) {
+        const std::string filename = "test-server-universe.csf";
+        const std::string delta_filename = "test-server-universe-delta.csf";
+
+        // Sorted by position, y first
+        std::vector<serialized_packet> data;
+        for (std::int32_t i = 0; i < 4; ++i) data.push_back(make_data(10*i));
+        std::vector<server::universe_serializer_record> records = {
+            make_record(0, space::vec_t(0,-3), data[0]),
+            make_record(1, space::vec_t(-5,0), data[1]),
+            make_record(2, space::vec_t(2,0),  data[2]),
+            make_record(3, space::vec_t(-1,6), data[3])
+        };
+
+        server::write_universe_file(filename, 8, records, compress);
+
+        {
+            server::v2::universe_file f(filename);
+            CHECK(f.header().depth == 8);
+            CHECK(f.object_count() == records.size());
+            CHECK(f.has_checksums());
+            f.verify();
+
+            for (std::size_t i = 0; i < records.size(); ++i) {
+                CHECK(same_record(f, i, records[i]));
+                CHECK(f.find(records[i].id) == i);
+                CHECK(f.find(records[i].position) == i);
+            }
+
+            CHECK(f.find(make_id(100)) == f.object_count());
+            CHECK(f.find(space::vec_t(1,0)) == f.object_count());
+
+            serialized_packet p = f.read_record(f.entry(2));
+            std::int32_t value = 0;
+            std::string str;
+            CHECK(p >> value >> str);
+            CHECK(value == 20 && str == std::string(20, 'x'));
+        }
+
+        // The delta removes a cell, replaces another with a new object, and adds a new one
+        serialized_packet new_data = make_data(50);
+        serialized_packet added_data = make_data(60);
+        std::vector<server::universe_serializer_record> delta = {
+            {uuid_t{}, space::vec_t(-5,0), server::v2::removed_type, nullptr, 0},
+            make_record(5, space::vec_t(2,0), new_data),
+            make_record(6, space::vec_t(7,1), added_data)
+        };
+
+        server::write_universe_file(delta_filename, 8, delta, compress);
+
+        {
+            server::v2::universe_file base(filename);
+            server::v2::universe_file diff(delta_filename);
+            diff.verify();
+            CHECK(diff.object_count() == delta.size());
+            CHECK(diff.entry(0).type == server::v2::removed_type);
+            CHECK(diff.entry(0).size == 0);
+
+            std::vector<server::universe_serializer_record> merged = read_records(base);
+            std::vector<server::universe_serializer_record> changes = read_records(diff);
+            server::merge_universe_delta(merged, changes);
+
+            CHECK(merged.size() == 4);
+            if (merged.size() == 4) {
+                CHECK(merged[0].id == records[0].id);
+                CHECK(merged[1].id == make_id(5) && merged[1].position == space::vec_t(2,0));
+                CHECK(merged[1].size == new_data.size());
+                CHECK(std::equal(new_data.data(), new_data.data() + new_data.size(),
+                    merged[1].data));
+                CHECK(merged[2].id == make_id(6) && merged[2].position == space::vec_t(7,1));
+                CHECK(merged[3].id == records[3].id);
+            }
+        }
+
+        file::remove(filename);
+        file::remove(delta_filename);
+    }
+
+    // A corrupted record is detected by the checksums
+    void test_v2_corrupted() {
+        const std::string filename = "test-server-universe-corrupted.csf";
+        serialized_packet data = make_data(100);
+        server::write_universe_file(filename, 8, {make_record(0, space::vec_t(0,0), data)},
+            false);
+
+        std::vector<char> content;
+        {
+            std::ifstream in(filename, std::ios::binary);
+            content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        const std::size_t record_offset = server::v2::universe_header::size +
+            server::v2::object_entry::size_on_disk;
+        CHECK(content.size() > record_offset + 10);
+        content[record_offset + 10] ^= 1;
+
+        {
+            std::ofstream out(filename, std::ios::binary);
+            out.write(content.data(), content.size());
+        }
+
+        bool thrown = false;
+        try {
+            server::v2::universe_file f(filename);
+            f.verify();
+        } catch (server::v2::universe_file::exception&) {
+            thrown = true;
+        }
+
+        CHECK(thrown);
+        file::remove(filename);
+    }
+
+    // Check that the records of a save match the objects of the universe
+    void check_saved_objects(const server::universe& u, const server::v2::universe_file& f,
+        std::size_t count) {
+        CHECK(f.object_count() == count);
+        for (std::size_t i = 0; i < f.object_count(); ++i) {
+            server::v2::object_entry e = f.entry(i);
+            const server::space_object* obj = u.find_object(e.id);
+            CHECK(obj && obj->cell() && obj->cell()->get_coordinates() == e.position);
+            if (!obj) continue;
+
+            serialized_packet p = f.read_record(e);
+            std::int32_t value = 0;
+            CHECK(p >> value);
+            CHECK(value == static_cast<const test_object*>(obj)->value);
+        }
+    }
+
+    // Saves only serialize again the objects that changed, and see all the changes
+    void test_incremental_save() {
+        const std::vector<std::string> dirs = {
+            "test-server-save-0/", "test-server-save-1/", "test-server-save-2/",
+            "test-server-save-3/", "test-server-save-4/"
+        };
+        for (auto& dir : dirs) file::mkdir(dir);
+
+        server::universe u;
+        const server::universe& cu = u;
+        u.object_factory().add_factory<test_object>(0);
+
+        // Enough objects for the cache of the saves to be split into several chunks
+        std::vector<serialized_packet> data;
+        std::vector<server::universe_serializer_record> records;
+        for (std::int32_t y = -16; y < 16; ++y)
+        for (std::int32_t x = -16; x < 16; ++x) {
+            serialized_packet p;
+            p << std::int32_t(data.size());
+            data.push_back(std::move(p));
+        }
+        for (std::uint32_t i = 0; i < data.size(); ++i) {
+            const space::vec_t pos(std::int32_t(i % 32) - 16, std::int32_t(i / 32) - 16);
+            records.push_back({make_id(i), pos, 0, data[i].data(), data[i].size()});
+        }
+
+        server::write_universe_file(dirs[0]+"universe.csf", 8, records, false);
+
+        auto s = u.make_serializer();
+        s->deserialize(dirs[0]);
+        s->load_data_first_pass();
+        s->load_data_second_pass();
+        CHECK(cu.find_object(make_id(10)) != nullptr);
+
+        // A pointer kept since before the first save
+        auto* kept = static_cast<test_object*>(u.find_object(make_id(700)));
+
+        s->save_data();
+        s->serialize(dirs[1]);
+        {
+            server::v2::universe_file f(dirs[1]+"universe.csf");
+            check_saved_objects(cu, f, records.size());
+        }
+
+        // Objects modified after a lookup, or that called touch(), are saved again
+        for (std::uint32_t i : {0, 500, 1023}) {
+            static_cast<test_object*>(u.find_object(make_id(i)))->value = 1000 + i;
+        }
+
+        kept->value = 7;
+        kept->touch();
+
+        // Objects removed or moved are saved again
+        u.find_object(make_id(300))->cell()->clear();
+        server::space_cell* c = u.find_object(make_id(31))->cell();
+        c->move_content_to(*c->reach(space::direction::right));
+
+        s->save_data();
+        s->serialize_delta(dirs[2], dirs[1]);
+        s->serialize(dirs[3]);
+
+        {
+            server::v2::universe_file full(dirs[3]+"universe.csf");
+            check_saved_objects(cu, full, records.size() - 1);
+
+            // The delta only holds the cells that changed, and completes the previous save
+            server::v2::universe_file base(dirs[1]+"universe.csf");
+            server::v2::universe_file delta(dirs[2]+"universe.csf");
+            CHECK(delta.object_count() == 7);
+
+            std::vector<server::universe_serializer_record> merged = read_records(base);
+            std::vector<server::universe_serializer_record> changes = read_records(delta);
+            server::merge_universe_delta(merged, changes);
+            std::vector<server::universe_serializer_record> expected = read_records(full);
+            CHECK(merged.size() == expected.size());
+            for (std::size_t i = 0; i < std::min(merged.size(), expected.size()); ++i) {
+                CHECK(merged[i].id == expected[i].id);
+                CHECK(merged[i].position == expected[i].position);
+                CHECK(merged[i].size == expected[i].size);
+                CHECK(std::equal(merged[i].data, merged[i].data + merged[i].size,
+                    expected[i].data));
+            }
+        }
+
+        // Nothing changed since the previous save
+        s->save_data();
+        s->serialize_delta(dirs[4], dirs[3]);
+        {
+            server::v2::universe_file delta(dirs[4]+"universe.csf");
+            CHECK(delta.object_count() == 0);
+        }
+
+        // Many objects removed or modified between saves, so that chunks shrink and merge
+        std::size_t count = records.size() - 1;
+        for (std::uint32_t round = 0; round < 8; ++round) {
+            for (std::uint32_t i = round; i < records.size(); i += 7) {
+                server::space_object* obj = u.find_object(make_id((i*37) % records.size()));
+                if (!obj) continue;
+                if (i % 2 == 0) {
+                    obj->cell()->clear();
+                    --count;
+                } else {
+                    static_cast<test_object*>(obj)->value = -std::int32_t(i);
+                }
+            }
+
+            s->save_data();
+            s->serialize(dirs[4]);
+            server::v2::universe_file f(dirs[4]+"universe.csf");
+            check_saved_objects(cu, f, count);
+        }
+
+        for (auto& dir : dirs) file::remove(dir);
+    }
+}
+
+int main() {
+    test_index_clear_with_readers();
+    test_v2_round_trip(false);
+    test_v2_round_trip(true);
+    test_v2_corrupted();
+    test_incremental_save();
+    return test_failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,639 @@
+#include <space.hpp>
+#include <xorshift.hpp>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include "test.hpp"
+
+namespace {
+    struct object {
+        int value;
+    };
+
+    // A universe of depth 1 is made of a single cell, which is its root
+    void test_depth_one() {
+        auto u = space::universe<object>::make<1>();
+        CHECK(u->size() == 1);
+        CHECK(u->depth() == 1);
+        CHECK(u->contains(space::vec_t(0,0)));
+        CHECK(!u->contains(space::vec_t(1,0)));
+        CHECK(u->object_count() == 0);
+
+        space::cell<object>& c = u->reach(space::vec_t(0,0));
+        c.fill(std::make_unique<object>(object{42}));
+        CHECK(u->object_count() == 1);
+        CHECK(c.get_coordinates() == space::vec_t(0,0));
+        CHECK(c.reach(space::direction::right) == nullptr);
+
+        int sum = 0;
+        u->for_each_cell([&](const object& o) { sum += o.value; });
+        CHECK(sum == 42);
+
+        std::atomic<int> parallel_sum(0);
+        u->parallel_for_each_cell([&](const object& o) { parallel_sum += o.value; });
+        CHECK(parallel_sum == 42);
+
+        // Readers do not prevent clearing a single cell universe
+        u->set_concurrent_reads(true);
+        {
+            auto guard = u->read();
+            c.clear();
+        }
+        u->collapse();
+        CHECK(u->object_count() == 0);
+    }
+
+    // The journal lists the cells that were filled, emptied or touched
+    void test_journal() {
+        auto u = space::universe<object>::make<6>();
+        u->reach(space::vec_t(3,-4)).fill(std::make_unique<object>(object{1}));
+        u->reach(space::vec_t(-7,2)).fill(std::make_unique<object>(object{2}));
+
+        u->set_journal_enabled(true);
+        std::uint64_t epoch = u->next_epoch();
+        u->reach(space::vec_t(3,-4)).touch();
+        u->reach(space::vec_t(5,5)).fill(std::make_unique<object>(object{3}));
+        u->reach(space::vec_t(-7,2)).clear();
+        u->collapse();
+
+        std::vector<space::vec_t> changes;
+        u->changes_since(epoch, changes);
+        CHECK(changes.size() == 3);
+        CHECK(std::find(changes.begin(), changes.end(), space::vec_t(3,-4)) != changes.end());
+        CHECK(std::find(changes.begin(), changes.end(), space::vec_t(5,5)) != changes.end());
+        CHECK(std::find(changes.begin(), changes.end(), space::vec_t(-7,2)) != changes.end());
+        CHECK(u->object_count() == 2);
+    }
+
+    // Universes created at runtime are linear, whatever their depth
+    void test_runtime_depth() {
+        auto t = space::universe<object>::make(std::size_t(10));
+        CHECK(t->depth() == 10);
+        CHECK(t->size() == 512);
+
+        auto l = space::universe<object>::make(space::max_linear_depth);
+        CHECK(l->depth() == space::max_linear_depth);
+        for (auto* u : {t.get(), l.get()}) {
+            bool thrown = false;
+            try {
+                space::cursor<object,10> c(*u, space::vec_t(0,0));
+            } catch (space::exception::invalid_cursor&) {
+                thrown = true;
+            }
+            CHECK(thrown);
+
+            thrown = false;
+            try {
+                u->set_concurrent_reads(true);
+            } catch (space::exception::invalid_storage&) {
+                thrown = true;
+            }
+            CHECK(thrown);
+        }
+
+        // The corners are reachable, anything past them is rejected without overflowing
+        const space::pos_t h = l->size()/2;
+        const space::pos_t pmax = std::numeric_limits<space::pos_t>::max();
+        l->reach(space::vec_t(-h, h-1)).fill(std::make_unique<object>(object{1}));
+        const space::cell<object>* c = l->try_reach(space::vec_t(-h, h-1));
+        CHECK(c && !c->empty() && c->get_coordinates() == space::vec_t(-h, h-1));
+        CHECK(l->try_reach(space::vec_t(h, 0)) == nullptr);
+        CHECK(l->try_reach(space::vec_t(pmax, -pmax)) == nullptr);
+        CHECK(t->try_reach(space::vec_t(pmax, -pmax)) == nullptr);
+        CHECK(l->object_count(space::vec_t(-h, h-1), 0) == 1);
+        CHECK(l->object_count(space::vec_t(pmax, pmax), 0) == 0);
+
+        for (std::size_t depth : {std::size_t(0), space::max_linear_depth + 1}) {
+            bool thrown = false;
+            try {
+                space::universe<object>::make(depth);
+            } catch (space::exception::invalid_depth&) {
+                thrown = true;
+            }
+            CHECK(thrown);
+        }
+    }
+
+    // A cursor visits the same cells as universe::try_reach(), and stops at the edges
+    void test_cursor() {
+        using space::direction;
+        auto u = space::universe<object>::make<4>();
+        const space::pos_t h = u->size()/2;
+        for (auto p : {space::vec_t(-h,-h), space::vec_t(h-1,h-1), space::vec_t(0,1),
+            space::vec_t(-2,3), space::vec_t(1,-3)}) {
+            u->reach(p).fill(std::make_unique<object>(object{p.x + 10*p.y}));
+        }
+
+        // Walk through all the cells, row by row, turning back at each edge
+        space::cursor<object,4> c(*u, space::vec_t(-h,-h));
+        CHECK(!c.move(direction::left));
+        CHECK(!c.move(direction::up));
+        CHECK(c.get_coordinates() == space::vec_t(-h,-h));
+
+        std::size_t visited = 0;
+        std::size_t found = 0;
+        direction dir = direction::right;
+        while (true) {
+            const space::vec_t p = c.get_coordinates();
+            CHECK(c.get() == u->try_reach(p));
+            if (!c.empty()) {
+                CHECK(c.get()->content().value == p.x + 10*p.y);
+                ++found;
+            }
+
+            ++visited;
+            if (!c.move(dir)) {
+                CHECK(c.get_coordinates() == p);
+                if (!c.move(direction::down)) break;
+                dir = (dir == direction::right ? direction::left : direction::right);
+            }
+        }
+
+        CHECK(visited == u->size()*u->size());
+        CHECK(found == u->object_count());
+        CHECK(c.get_coordinates() == space::vec_t(-h,h-1));
+        CHECK(!c.move(direction::down));
+        CHECK(!c.move(direction::left));
+
+        // Creating a cell through the cursor
+        c.move_to(space::vec_t(2,2));
+        CHECK(c.empty());
+        c.reach().fill(std::make_unique<object>(object{22}));
+        CHECK(u->try_reach(space::vec_t(2,2)) == c.get());
+
+        // A cursor created from a cell, in the opposite corner
+        space::cursor<object,4> d(u->reach(space::vec_t(h-1,h-1)));
+        CHECK(d.get_coordinates() == space::vec_t(h-1,h-1));
+        CHECK(!d.move(direction::right));
+        CHECK(!d.move(direction::down));
+        CHECK(d.move(direction::up));
+        CHECK(d.get() == u->try_reach(space::vec_t(h-1,h-2)));
+
+        // Positions outside of the universe are rejected, and the cursor does not move
+        const space::pos_t pmax = std::numeric_limits<space::pos_t>::max();
+        const space::pos_t pmin = std::numeric_limits<space::pos_t>::min();
+        for (auto p : {space::vec_t(h,0), space::vec_t(0,-h-1), space::vec_t(pmax,pmin)}) {
+            bool thrown = false;
+            try {
+                d.move_to(p);
+            } catch (space::exception::invalid_position&) {
+                thrown = true;
+            }
+            CHECK(thrown);
+            CHECK(d.get_coordinates() == space::vec_t(h-1,h-2));
+        }
+
+        // Same at the edge of the deepest universe, where the offset positions would overflow
+        auto deep = space::universe<object>::make<31>();
+        const space::pos_t dh = deep->size()/2;
+        space::cursor<object,31> e(*deep, space::vec_t(dh-1,-dh));
+        CHECK(!e.move(direction::right));
+        CHECK(!e.move(direction::up));
+        CHECK(e.move(direction::left));
+        CHECK(e.get_coordinates() == space::vec_t(dh-2,-dh));
+        for (auto p : {space::vec_t(dh,0), space::vec_t(pmax,pmax), space::vec_t(pmin,0)}) {
+            bool thrown = false;
+            try {
+                e.move_to(p);
+            } catch (space::exception::invalid_position&) {
+                thrown = true;
+            }
+            CHECK(thrown);
+
+            thrown = false;
+            try {
+                space::cursor<object,31> f(*deep, p);
+            } catch (space::exception::invalid_position&) {
+                thrown = true;
+            }
+            CHECK(thrown);
+        }
+
+        // Cursors only work with quad-trees of the same depth
+        auto l = space::universe<object>::make<4>(space::storage::linear);
+        for (auto* v : {l.get(), deep.get()}) {
+            bool thrown = false;
+            try {
+                space::cursor<object,4> g(*v, space::vec_t(0,0));
+            } catch (space::exception::invalid_cursor&) {
+                thrown = true;
+            }
+            CHECK(thrown);
+        }
+    }
+
+    // A cell emptied over and over does not make the collapse queue grow without bounds
+    void test_collapse_queue(space::storage s) {
+        auto u = space::universe<object>::make<6>(s);
+        space::cell<object>& c = u->reach(space::vec_t(1,2));
+        c.fill(std::make_unique<object>(object{1}));
+        c.clear();
+        const std::size_t bytes = u->memory_usage().structure_bytes;
+
+        for (std::size_t i = 0; i < 100000; ++i) {
+            c.fill(std::make_unique<object>(object{1}));
+            c.clear();
+        }
+
+        CHECK(u->memory_usage().structure_bytes < bytes + 64*1024);
+
+        u->set_collapse_delay(0);
+        u->collapse();
+        CHECK(u->try_reach(space::vec_t(1,2)) == nullptr);
+        CHECK(u->object_count() == 0);
+    }
+
+    // Return the value of the object at the provided position, or -1 if there is none
+    int value_at(const space::universe<object>& u, const space::vec_t& pos) {
+        const space::cell<object>* c = u.try_reach(pos);
+        return c && !c->empty() ? c->content().value : -1;
+    }
+
+    // Moves are applied simultaneously, and conflicting moves are rejected in list order
+    void test_bulk_move(space::storage s) {
+        auto u = space::universe<object>::make<4>(s);
+        const std::vector<std::pair<space::vec_t,int>> objects = {
+            {space::vec_t(0,0), 1}, {space::vec_t(1,0), 2}, {space::vec_t(2,0), 3},
+            {space::vec_t(-3,-3), 4}, {space::vec_t(3,3), 5}, {space::vec_t(-1,2), 6},
+            {space::vec_t(-2,2), 7}, {space::vec_t(-4,1), 8}, {space::vec_t(1,1), 9},
+            {space::vec_t(3,-4), 10}
+        };
+        for (auto& o : objects) u->reach(o.first).fill(std::make_unique<object>(object{o.second}));
+
+        using move = space::universe<object>::object_move;
+        std::vector<move> moves = {
+            move(space::vec_t(0,0),   space::vec_t(1,0)),   // swap
+            move(space::vec_t(1,0),   space::vec_t(0,0)),   // swap
+            move(space::vec_t(2,0),   space::vec_t(2,1)),   // free destination
+            move(space::vec_t(-3,-3), space::vec_t(3,3)),   // occupied by an object that stays
+            move(space::vec_t(-1,2),  space::vec_t(0,3)),   // first to reach (0,3)
+            move(space::vec_t(-2,2),  space::vec_t(0,3)),   // second to reach (0,3)
+            move(space::vec_t(1,1),   space::vec_t(-3,-3)), // blocked by a rejected move
+            move(space::vec_t(-4,1),  space::vec_t(-4,0)),  // free destination
+            move(space::vec_t(2,-2),  space::vec_t(2,-1)),  // empty source
+            move(space::vec_t(3,-4),  space::vec_t(50,0)),  // destination outside
+            move(space::vec_t(-50,0), space::vec_t(0,-1)),  // source outside
+            move(space::vec_t(0,0),   space::vec_t(-1,-1)), // same source as the first move
+            move(space::vec_t(3,3),   space::vec_t(3,3))    // ignored
+        };
+
+        CHECK(u->bulk_move(moves) == 7);
+        const std::vector<move> rejected = {
+            move(space::vec_t(-3,-3), space::vec_t(3,3)),
+            move(space::vec_t(-2,2),  space::vec_t(0,3)),
+            move(space::vec_t(1,1),   space::vec_t(-3,-3)),
+            move(space::vec_t(2,-2),  space::vec_t(2,-1)),
+            move(space::vec_t(3,-4),  space::vec_t(50,0)),
+            move(space::vec_t(-50,0), space::vec_t(0,-1)),
+            move(space::vec_t(0,0),   space::vec_t(-1,-1))
+        };
+        CHECK(moves == rejected);
+
+        CHECK(value_at(*u, space::vec_t(0,0))   == 2);
+        CHECK(value_at(*u, space::vec_t(1,0))   == 1);
+        CHECK(value_at(*u, space::vec_t(2,0))   == -1);
+        CHECK(value_at(*u, space::vec_t(2,1))   == 3);
+        CHECK(value_at(*u, space::vec_t(-3,-3)) == 4);
+        CHECK(value_at(*u, space::vec_t(3,3))   == 5);
+        CHECK(value_at(*u, space::vec_t(-1,2))  == -1);
+        CHECK(value_at(*u, space::vec_t(0,3))   == 6);
+        CHECK(value_at(*u, space::vec_t(-2,2))  == 7);
+        CHECK(value_at(*u, space::vec_t(1,1))   == 9);
+        CHECK(value_at(*u, space::vec_t(-4,1))  == -1);
+        CHECK(value_at(*u, space::vec_t(-4,0))  == 8);
+        CHECK(value_at(*u, space::vec_t(3,-4))  == 10);
+        CHECK(value_at(*u, space::vec_t(-1,-1)) == -1);
+        CHECK(u->object_count() == objects.size());
+
+        // A rotation of three objects, all moving into a cell that is being left
+        moves = {
+            move(space::vec_t(0,0), space::vec_t(1,0)),
+            move(space::vec_t(1,0), space::vec_t(2,1)),
+            move(space::vec_t(2,1), space::vec_t(0,0))
+        };
+        CHECK(u->bulk_move(moves) == 0);
+        CHECK(moves.empty());
+        CHECK(value_at(*u, space::vec_t(0,0)) == 3);
+        CHECK(value_at(*u, space::vec_t(1,0)) == 2);
+        CHECK(value_at(*u, space::vec_t(2,1)) == 1);
+        CHECK(u->object_count() == objects.size());
+    }
+
+    // Return a random position, which may lie up to 'margin' cells outside of the universe
+    space::vec_t random_position(xorshift& rng, const space::universe<object>& u,
+        space::pos_t margin = 0) {
+        const space::pos_t s = u.size();
+        return space::vec_t(
+            space::pos_t(rng() % (s + 2*margin)) - s/2 - margin,
+            space::pos_t(rng() % (s + 2*margin)) - s/2 - margin
+        );
+    }
+
+    // The linear storage behaves as the quad-tree for the same sequence of operations
+    void test_linear_storage() {
+        using space::direction;
+        auto t = space::universe<object>::make<6>(space::storage::tree);
+        auto l = space::universe<object>::make<6>(space::storage::linear);
+        const std::vector<space::universe<object>*> both = {t.get(), l.get()};
+        const space::pos_t h = t->size()/2;
+        xorshift rng(12);
+
+        for (std::size_t step = 0; step < 3000; ++step) {
+            const space::vec_t p = random_position(rng, *t);
+            const std::uint32_t op = rng() % 4;
+            const direction dir = direction(rng() % 4);
+
+            for (auto* u : both) {
+                space::cell<object>& c = u->reach(p);
+                if (op == 0 || op == 1) {
+                    // Insert
+                    if (c.empty()) c.fill(std::make_unique<object>(object{int(step)}));
+                } else if (op == 2) {
+                    // Move to a neighbour, if it exists and is free
+                    space::cell<object>* n = c.reach(dir);
+                    if (n && n->empty()) c.move_content_to(*n);
+                } else {
+                    // Erase
+                    c.clear();
+                }
+            }
+
+            if (step % 500 == 499) {
+                for (auto* u : both) u->collapse();
+            }
+        }
+
+        CHECK(t->object_count() == l->object_count());
+        CHECK(t->object_count() > 0);
+
+        for (space::pos_t y = -h; y < h; ++y)
+        for (space::pos_t x = -h; x < h; ++x) {
+            const space::vec_t p(x,y);
+            CHECK(value_at(*t, p) == value_at(*l, p));
+
+            // Neighbours, including past the edges
+            for (std::size_t d = 0; d < 4; ++d) {
+                const space::cell<object>* tc = t->try_reach(p);
+                const space::cell<object>* lc = l->try_reach(p);
+                if (!tc || !lc) continue;
+
+                const space::cell<object>* tn = tc->try_reach(direction(d));
+                const space::cell<object>* ln = lc->try_reach(direction(d));
+                CHECK((tn && !tn->empty()) == (ln && !ln->empty()));
+                if (tn && ln) CHECK(tn->get_coordinates() == ln->get_coordinates());
+                if (tn && !tn->empty() && ln && !ln->empty()) {
+                    CHECK(tn->content().value == ln->content().value);
+                }
+            }
+        }
+
+        // Both storages list the cells of a box in Z-order
+        for (std::size_t i = 0; i < 100; ++i) {
+            const space::vec_t p1 = random_position(rng, *t, 4);
+            const space::vec_t p2 = p1 + space::vec_t(rng() % 20, rng() % 20);
+            const space::box_t box(p1, p2);
+
+            std::vector<std::pair<space::vec_t,int>> tcells, lcells;
+            for (const space::cell<object>& c : t->query(box)) {
+                tcells.emplace_back(c.get_coordinates(), c.content().value);
+            }
+            for (const space::cell<object>& c : l->query(box)) {
+                lcells.emplace_back(c.get_coordinates(), c.content().value);
+            }
+
+            CHECK(tcells == lcells);
+        }
+    }
+
+    // Placing a batch gives the same result as placing its objects one by one, in order
+    void test_bulk_fill(space::storage s) {
+        auto bulk = space::universe<object>::make<6>(s);
+        auto single = space::universe<object>::make<6>(s);
+        const space::pos_t h = bulk->size()/2;
+        xorshift rng(34);
+
+        // Some cells are already occupied
+        for (std::size_t i = 0; i < 50; ++i) {
+            const space::vec_t p = random_position(rng, *bulk);
+            for (auto* u : {bulk.get(), single.get()}) {
+                space::cell<object>& c = u->reach(p);
+                if (c.empty()) c.fill(std::make_unique<object>(object{-int(i)-1}));
+            }
+        }
+
+        // The batch has duplicate positions, and positions outside of the universe
+        using positioned_object = space::universe<object>::positioned_object;
+        std::vector<positioned_object> objects;
+        for (std::size_t i = 0; i < 400; ++i) {
+            objects.emplace_back(random_position(rng, *bulk, 2),
+                std::make_unique<object>(object{int(i)}));
+        }
+
+        std::vector<bool> placed;
+        std::size_t nfail = 0;
+        for (auto& o : objects) {
+            const bool ok = single->contains(o.first) && single->reach(o.first).empty();
+            if (ok) single->reach(o.first).fill(std::make_unique<object>(*o.second));
+            else ++nfail;
+            placed.push_back(ok);
+        }
+
+        CHECK(nfail > 0);
+        CHECK(bulk->bulk_fill(objects) == nfail);
+        CHECK(objects.size() == placed.size());
+        for (std::size_t i = 0; i < objects.size(); ++i) {
+            // The objects that were not placed are left in the list, untouched
+            CHECK((objects[i].second == nullptr) == placed[i]);
+            if (objects[i].second) CHECK(objects[i].second->value == int(i));
+        }
+
+        CHECK(bulk->object_count() == single->object_count());
+        for (space::pos_t y = -h; y < h; ++y)
+        for (space::pos_t x = -h; x < h; ++x) {
+            CHECK(value_at(*bulk, space::vec_t(x,y)) == value_at(*single, space::vec_t(x,y)));
+        }
+    }
+
+    // Fill random cells of the universe, and return the number of objects placed
+    std::size_t fill_random(space::universe<object>& u, xorshift& rng, std::size_t n) {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            space::cell<object>& c = u.reach(random_position(rng, u));
+            if (c.empty()) {
+                c.fill(std::make_unique<object>(object{int(i)}));
+                ++count;
+            }
+        }
+
+        return count;
+    }
+
+    // query() and clip() select the same cells as a scan of the whole universe
+    void test_query(space::storage s) {
+        auto u = space::universe<object>::make<6>(s);
+        const space::pos_t h = u->size()/2;
+        xorshift rng(56);
+        fill_random(*u, rng, 300);
+
+        // Empty the cells of a region, without collapsing them
+        for (const space::vec_t& p : {space::vec_t(0,0), space::vec_t(1,0), space::vec_t(0,1)}) {
+            u->reach(p).clear();
+        }
+
+        const space::pos_t pmax = std::numeric_limits<space::pos_t>::max();
+        const space::pos_t pmin = std::numeric_limits<space::pos_t>::min();
+        std::vector<space::box_t> boxes = {
+            space::box_t(space::vec_t(-h,-h), space::vec_t(h-1,h-1)),
+            space::box_t(space::vec_t(pmin,pmin), space::vec_t(pmax,pmax)),
+            space::box_t(space::vec_t(-1,-1), space::vec_t(1,1)),
+            space::box_t(space::vec_t(3,3), space::vec_t(3,3)),
+            space::box_t(space::vec_t(5,5), space::vec_t(4,5)),
+            space::box_t(space::vec_t(h,0), space::vec_t(pmax,pmax))
+        };
+        for (std::size_t i = 0; i < 100; ++i) {
+            const space::vec_t p1 = random_position(rng, *u, 8);
+            boxes.emplace_back(p1, p1 + space::vec_t(rng() % 30, rng() % 30));
+        }
+
+        for (const space::box_t& box : boxes) {
+            std::vector<space::vec_t> found;
+            std::uint64_t last = 0;
+            for (const space::cell<object>& c : u->query(box)) {
+                const space::vec_t p = c.get_coordinates();
+                CHECK(!c.empty());
+                CHECK(c.content().value == value_at(*u, p));
+
+                // In Z-order, without duplicates
+                const std::uint64_t key = space::impl::morton_encode(
+                    space::impl::vec_t(p + space::vec_t(h,h)));
+                CHECK(found.empty() || key > last);
+                last = key;
+                found.push_back(p);
+            }
+
+            std::size_t expected = 0;
+            for (space::pos_t y = -h; y < h; ++y)
+            for (space::pos_t x = -h; x < h; ++x) {
+                if (value_at(*u, space::vec_t(x,y)) < 0) continue;
+                if (x < box.p1.x || x > box.p2.x || y < box.p1.y || y > box.p2.y) continue;
+                CHECK(std::find(found.begin(), found.end(), space::vec_t(x,y)) != found.end());
+                ++expected;
+            }
+
+            CHECK(found.size() == expected);
+        }
+
+        // A unit cell is selected by clip() if it overlaps with the box
+        ctl::sorted_vector<const space::cell<object>&> all;
+        for (std::size_t i = 0; i < 100; ++i) {
+            const vec2d p1(int(rng() % 80) - 40 + (rng() % 4)/4.0,
+                int(rng() % 80) - 40 + (rng() % 4)/4.0);
+            const vec2d p2 = p1 + vec2d((rng() % 40)/4.0, (rng() % 40)/4.0);
+            const axis_aligned_box2d box(p1, p2);
+
+            ctl::sorted_vector<const space::cell<object>&> list;
+            u->clip(box, list);
+            u->clip(box, all);
+
+            std::size_t expected = 0;
+            for (space::pos_t y = -h; y < h; ++y)
+            for (space::pos_t x = -h; x < h; ++x) {
+                const space::cell<object>* c = u->try_reach(space::vec_t(x,y));
+                if (!c || c->empty()) continue;
+                if (x >= p2.x || x + 1 <= p1.x || y >= p2.y || y + 1 <= p1.y) continue;
+                CHECK(list.find(*c) != list.end());
+                CHECK(all.find(*c) != all.end());
+                ++expected;
+            }
+
+            CHECK(list.size() == expected);
+        }
+
+        CHECK(all.size() <= u->object_count());
+    }
+
+    // Check density_map() and object_count() against a scan of the universe
+    void check_density(const space::universe<object>& u) {
+        const space::pos_t h = u.size()/2;
+        std::size_t total = 0;
+        for (std::size_t level = 0; level <= u.depth(); ++level) {
+            // Levels past the unit cells are treated as the unit cells
+            const std::size_t l = std::min(level, u.depth()-1);
+            const std::size_t n = std::size_t(1) << l;
+            const space::pos_t region = u.size() >> l;
+
+            std::vector<std::size_t> expected(n*n, 0);
+            for (space::pos_t y = -h; y < h; ++y)
+            for (space::pos_t x = -h; x < h; ++x) {
+                if (value_at(u, space::vec_t(x,y)) < 0) continue;
+                ++expected[(x+h)/region + n*((y+h)/region)];
+                if (level == 0) ++total;
+            }
+
+            std::vector<std::size_t> map;
+            u.density_map(level, map);
+            CHECK(map == expected);
+
+            for (std::size_t i = 0; i < n*n; ++i) {
+                const space::vec_t corner(space::pos_t(i % n)*region - h,
+                    space::pos_t(i / n)*region - h);
+                CHECK(u.object_count(corner, level) == expected[i]);
+                CHECK(u.object_count(corner + space::vec_t(region-1, region-1), level) ==
+                    expected[i]);
+            }
+        }
+
+        CHECK(u.object_count() == total);
+        CHECK(u.object_count(space::vec_t(h,0), 0) == 0);
+        CHECK(u.object_count(space::vec_t(0,-h-1), 3) == 0);
+    }
+
+    // The object counts follow inserts and removals
+    void test_density(space::storage s) {
+        auto u = space::universe<object>::make<6>(s);
+        xorshift rng(78);
+        check_density(*u);
+
+        CHECK(fill_random(*u, rng, 200) == u->object_count());
+        check_density(*u);
+
+        // Remove some objects in different ways, and move some others
+        for (std::size_t i = 0; i < 200; ++i) {
+            space::cell<object>& c = u->reach(random_position(rng, *u));
+            switch (rng() % 3) {
+            case 0 : c.clear(); break;
+            case 1 : c.release(); break;
+            case 2 : {
+                space::cell<object>* n = c.reach(space::direction(rng() % 4));
+                if (n && n->empty()) c.move_content_to(*n);
+                break;
+            }
+            }
+        }
+
+        check_density(*u);
+
+        u->set_collapse_delay(0);
+        u->collapse();
+        check_density(*u);
+    }
+}
+
+int main() {
+    test_depth_one();
+    test_journal();
+    test_runtime_depth();
+    test_cursor();
+    test_collapse_queue(space::storage::tree);
+    test_collapse_queue(space::storage::linear);
+    test_bulk_move(space::storage::tree);
+    test_bulk_move(space::storage::linear);
+    test_linear_storage();
+    test_bulk_fill(space::storage::tree);
+    test_bulk_fill(space::storage::linear);
+    test_query(space::storage::tree);
+    test_query(space::storage::linear);
+    test_density(space::storage::tree);
+    test_density(space::storage::linear);
+    return test_failures() == 0 ? 0 : 1;
+}
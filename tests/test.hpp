@@ -0,0 +1,21 @@
+#ifndef TEST_HPP
+#define TEST_HPP
+
+#include <iostream>
+
+/// Number of failed checks, reported as the exit status of the test program.
+inline int& test_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+/// Check a condition, and report the failure without stopping the test.
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+            ++test_failures(); \
+        } \
+    } while (false)
+
+#endif
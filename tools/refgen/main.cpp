@@ -212,6 +212,54 @@ CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData client
     return CXChildVisit_Recurse;
 }
 
+// Specialization of packet_impl::serialized, to compute the size of a packet and encode it
+// in one pass. All the specializations of a file must be declared before any of them is
+// used, since packets can contain each other.
+void generate_serialized_code(std::ostream& out, const packet& p) {
+    std::string member_types;
+    for (auto& m : p.members) {
+        if (!member_types.empty()) member_types += ", ";
+        member_types += "decltype(T::" + m.name + ")";
+    }
+
+    out << "template<>\n";
+    out << "struct packet_impl::serialized<" << p.name << "> {\n";
+    out << "    template<typename T = " << p.name << ">\n";
+    out << "    static constexpr bool supported() {\n";
+    out << "        return packet_impl::all_supported<" << member_types << ">();\n";
+    out << "    }\n";
+    out << "    template<typename T = " << p.name << ">\n";
+    out << "    static constexpr std::size_t max_size() {\n";
+    out << "        return packet_impl::max_size_of<" << member_types << ">();\n";
+    out << "    }\n";
+    out << "    template<typename T>\n";
+    out << "    static std::size_t size(const T& t) {\n";
+    out << "        return 0";
+    for (auto& m : p.members) {
+        out << "\n            + packet_impl::serialized<decltype(T::" << m.name << ")>::size(t."
+            << m.name << ")";
+    }
+    out << ";\n";
+    out << "    }\n";
+    out << "    template<typename T>\n";
+    out << "    static char* write(char* out, const T& t) {\n";
+    for (auto& m : p.members) {
+        out << "        out = packet_impl::serialized<decltype(T::" << m.name << ")>::write(out, t."
+            << m.name << ");\n";
+    }
+    out << "        return out;\n";
+    out << "    }\n";
+    out << "    template<typename T>\n";
+    out << "    static const char* read(const char* in, T& t) {\n";
+    for (auto& m : p.members) {
+        out << "        in = packet_impl::serialized<decltype(T::" << m.name << ")>::read(in, t."
+            << m.name << ");\n";
+    }
+    out << "        return in;\n";
+    out << "    }\n";
+    out << "};\n\n";
+}
+
 void generate_code(std::ostream& out, const packet& p) {
     out << "// " << p.name << ": " << p.lstart << ":" << p.cstart << " to "
         << p.lend << ":" << p.cend << "\n";
@@ -246,25 +294,29 @@ void generate_code(std::ostream& out, const packet& p) {
         out << " return p; ";
     }
     out << "}\n";
-    out << "static inline packet_t::base& operator >> (packet_t::base& p, "
-        << p.name << "& t) {";
-    if (!p.members.empty()) {
-        out << "\n";
-        for (auto& m : p.members) {
-            if (m.is_enum) {
-                out << "    typename std::underlying_type<"
-                    << m.type << ">::type " << m.name << "_underlying;\n";
-                out << "    p >> " << m.name << "_underlying;\n";
-                out << "    t." << m.name << " = static_cast<" << m.type << ">(" << m.name << "_underlying);\n";
-            } else {
-                out << "    p >> t." << m.name << ";\n";
+    // Readers from packets, and from packet views (which decode without copying)
+    for (std::string stream : {"packet_t::base", "serialized_packet_view"}) {
+        out << "static inline " << stream << "& operator >> (" << stream << "& p, "
+            << p.name << "& t) {";
+        if (!p.members.empty()) {
+            out << "\n";
+            out << "    if (packet_impl::read_fixed(p, t)) return p;\n";
+            for (auto& m : p.members) {
+                if (m.is_enum) {
+                    out << "    typename std::underlying_type<"
+                        << m.type << ">::type " << m.name << "_underlying;\n";
+                    out << "    p >> " << m.name << "_underlying;\n";
+                    out << "    t." << m.name << " = static_cast<" << m.type << ">(" << m.name << "_underlying);\n";
+                } else {
+                    out << "    p >> t." << m.name << ";\n";
+                }
             }
+            out << "    return p;\n";
+        } else {
+            out << " return p; ";
         }
-        out << "    return p;\n";
-    } else {
-        out << " return p; ";
+        out << "}\n";
     }
-    out << "}\n";
     out << std::string(nsp.size(),'}');
     out << "\n";
 
@@ -455,6 +507,10 @@ bool parse(const std::string& dir, const std::string& filename, std::deque<packe
         return false;
     }
 
+    for (auto iter = data.db.begin(); iter != data.db.end(); ++iter) {
+        generate_serialized_code(out, *iter);
+    }
+
     for (auto iter = data.db.begin(); iter != data.db.end(); ++iter) {
         generate_code(out, *iter);
     }